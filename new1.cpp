@@ -2,15 +2,39 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <queue>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <deque>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
 // Instruction types
-enum InsnType { BRANCH, STORE, LOAD, ARITHMETIC, NOP, SPLOOP, SPKERNEL, SPMASK, OTHER };
+enum InsnType { BRANCH, STORE, LOAD, ARITHMETIC, NOP, SPLOOP, SPKERNEL, SPMASK, OTHER, SEMIHOST };
 
 // Instruction structure
 struct Instruction {
@@ -22,6 +46,7 @@ struct Instruction {
     string operands;
     int line_num;
     bool parallel;
+    int target_sym = -1;  // Branch target symbol ID, resolved at load time
 };
 
 // Execute Packet (EP) - instructions executed in parallel
@@ -31,86 +56,3058 @@ struct ExecutePacket {
     int ep_num;
 };
 
+// Precise-state side table entry for one emitted host instruction. Within an EP
+// the translation emits loads and ALU ops first and deferred stores last.
+struct StateMapEntry {
+    int ep_pos;   // EP position within the TB
+    int insn;     // Instruction index within the guest EP
+};
+
+// Delay-slot result still in flight at an EP boundary (branch or load)
+struct PendingResult {
+    int remaining_delay;
+    int instruction_line;
+    bool branch;
+};
+
+// Assumption a specialized TB was translated under, checked on TB entry
+enum SpecKind { SPEC_PREDICATE, SPEC_ILC, SPEC_VALUE, SPEC_KIND_COUNT };
+
+struct SpecGuard {
+    SpecKind kind;
+    string reg;        // Guest register ("ILC" for SPEC_ILC)
+    int32_t expected;  // Predicates: 0 (false) or 1 (true)
+};
+
+// Values seen in one live-in register at TB entry
+struct ValueProfile {
+    string reg;
+    int32_t value = 0;
+    int runs = 0;      // Consecutive entries with this value
+};
+
 // Translation Block (TB)
 struct TranslationBlock {
     vector<ExecutePacket> packets;
     int tb_id;
     int max_cycles;
-    string start_label;
+    int label_sym = -1;   // TB label symbol ID (e.g. NESTED_STATE_2)
+    bool kernel_loop = false;  // SPLOOP kernel, re-entered once per iteration
     int start_ep_index;
     int end_ep_index;
+    
+    // Code cache placement and profile
+    uint64_t exec_count = 0;
+    int chain_next = -1;  // TB most recently chained to from this one
+    int host_offset = -1; // Body offset in the code cache
+    int host_size = 0;
+    int exit_stubs = 0;   // Side-exit stubs (one per branch plus fall-through)
+    int semihost_traps = 0;  // SWE instructions, each a call into the host
+    int stub_offset = -1;
+    int cycle_cost = 0;   // Static cycle cost (sum of EP cycles)
+    
+    // Debugging: a TB with a breakpoint is replaced by a retranslation that
+    // carries the trap; the stale TB forwards to it
+    int image = 0;              // Guest image the TB was translated from
+    bool valid = true;
+    int replaced_by = -1;
+    vector<int> trap_eps;       // EP indices that trap before executing
+    
+    // Precise-state side tables, built at registration and only read on a fault
+    vector<StateMapEntry> state_map;      // Indexed by host instruction position
+    vector<PendingResult> pending_results;
+    vector<int> pending_begin;            // Per EP: first pending result (plus end sentinel)
+    
+    // Guest registers the TB reads and writes, and the ones its chain group
+    // keeps in host registers
+    vector<int> reg_reads;
+    vector<int> reg_writes;
+    vector<int> live_in;        // Read before anything in the TB writes them
+    int reg_group = -1;
+    vector<int> cached_regs;
+    
+    // Speculation: callers always hold the generic TB, which forwards to its
+    // current specialization while the specialization's guards hold
+    vector<SpecGuard> guards;
+    int generic_tb = -1;        // On a specialized TB
+    int specialized = -1;       // On a generic TB
+    bool profiled = false;
+    vector<ValueProfile> value_profile;
 };
 
-// Context for saving unexpired instructions
-struct SavedContext {
-    int remaining_delay;
-    string target_address;
-    int instruction_line;
+// Host memory backing guest regions and the code cache. Huge pages are tried
+// first (explicit hugetlbfs, then transparent huge pages) and the mapping falls
+// back to ordinary 4K pages when neither is available.
+struct HostMapping {
+    enum Backing { UNMAPPED, HUGETLB, THP, SMALL_PAGES, FILE_READ_ONLY, FILE_COPY_ON_WRITE };
+    uint8_t* base = nullptr;
+    size_t size = 0;
+    Backing backing = UNMAPPED;
+    
+    static const size_t kHugePageSize = 2u << 20;
+    
+    static const char* backingName(Backing b) {
+        switch (b) {
+            case HUGETLB: return "hugetlb";
+            case THP: return "transparent huge pages";
+            case SMALL_PAGES: return "4K pages";
+            case FILE_READ_ONLY: return "file, read-only";
+            case FILE_COPY_ON_WRITE: return "file, copy-on-write";
+            default: return "unmapped";
+        }
+    }
+    
+    static HostMapping map(size_t size, bool executable, bool huge_pages) {
+        HostMapping m;
+        int prot = PROT_READ | PROT_WRITE | (executable ? PROT_EXEC : 0);
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+        
+        if (huge_pages) {
+            size = (size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+#ifdef MAP_HUGETLB
+            // No MAP_NORESERVE here: an unbacked hugetlb mapping would SIGBUS on first touch
+            void* p = mmap(nullptr, size, prot, (flags & ~MAP_NORESERVE) | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                m.base = (uint8_t*)p;
+                m.size = size;
+                m.backing = HUGETLB;
+                return m;
+            }
+#endif
+#ifdef MADV_HUGEPAGE
+            // Over-allocate so the region can be trimmed to a 2M boundary
+            void* raw = mmap(nullptr, size + kHugePageSize, prot, flags, -1, 0);
+            if (raw != MAP_FAILED) {
+                uintptr_t start = ((uintptr_t)raw + kHugePageSize - 1) & ~(uintptr_t)(kHugePageSize - 1);
+                size_t head = start - (uintptr_t)raw;
+                if (head) munmap(raw, head);
+                size_t tail = kHugePageSize - head;
+                if (tail) munmap((void*)(start + size), tail);
+                m.base = (uint8_t*)start;
+                m.size = size;
+                m.backing = madvise(m.base, size, MADV_HUGEPAGE) == 0 ? THP : SMALL_PAGES;
+                return m;
+            }
+#endif
+        }
+        
+        void* p = mmap(nullptr, size, prot, flags, -1, 0);
+        if (p != MAP_FAILED) {
+            m.base = (uint8_t*)p;
+            m.size = size;
+            m.backing = SMALL_PAGES;
+        }
+        return m;
+    }
+    
+    // Map a host file directly; pages are faulted in on first guest access so
+    // only the touched working set becomes resident. Copy-on-write mappings
+    // accept guest stores without ever writing them back to the file.
+    static HostMapping mapFile(const string& path, bool copy_on_write) {
+        HostMapping m;
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return m;
+        
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            int prot = copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+            int flags = copy_on_write ? MAP_PRIVATE : MAP_SHARED;
+            void* p = mmap(nullptr, (size_t)st.st_size, prot, flags | MAP_NORESERVE, fd, 0);
+            if (p != MAP_FAILED) {
+                m.base = (uint8_t*)p;
+                m.size = (size_t)st.st_size;
+                m.backing = copy_on_write ? FILE_COPY_ON_WRITE : FILE_READ_ONLY;
+            }
+        }
+        close(fd);  // The mapping keeps the file referenced
+        return m;
+    }
+    
+    void unmap() {
+        if (base) munmap(base, size);
+        base = nullptr;
+        size = 0;
+        backing = UNMAPPED;
+    }
+};
+
+// Guest physical memory region backed by a host mapping
+struct MemoryRegion {
+    string name;
+    uint32_t guest_base;
+    size_t size;        // Guest-visible size (host mapping may be rounded up)
+    bool writable;
+    HostMapping host;
+    bool shared = false;  // Visible to every core (MSMC); accesses are counted
+    bool owned = true;    // Unmapped by this core on destruction
+};
+
+// Simulator configuration (command-line options)
+struct SimOptions {
+    bool huge_pages = false;
+    size_t ddr_size = 256u << 20;
+    string ddr_file;               // Input capture mapped into DDR, if any
+    bool ddr_file_cow = false;
+    uint32_t ddr_file_base = 0x90000000;
+    string fifo_in;                // Host files streamed through the sample FIFO
+    string fifo_out;
+    int cores = 4;                 // Cores in the multi-core run (1 disables it)
+    int gdb_port = 0;              // Wait for GDB on this port before running (0 disables it)
+    int host_threads = 0;          // Host threads for long vectorized SPLOOPs (0: one per host CPU)
+};
+
+// Memory-mapped sample FIFO for streaming DSP workloads. Input samples are read
+// straight out of an mmap'd host file, and the guest can also borrow a pointer
+// to the next batch of samples without any copy. Output samples collect in a
+// large ring that is written back to the host file one half-ring at a time.
+class SampleFifo {
+public:
+    static const uint32_t kBase = 0x02A00000;
+    static const uint32_t kSize = 0x100;
+    enum Register {
+        IN_DATA = 0x00,    // Read: next input sample (0 once drained)
+        IN_LEVEL = 0x04,   // Read: input samples remaining
+        OUT_DATA = 0x08,   // Write: append an output sample
+        OUT_COUNT = 0x0C,  // Read: output samples written so far
+        CTRL = 0x10        // Write 1: flush output to the host file
+    };
+    static const size_t kOutRingSamples = 1u << 16;
+
+    SampleFifo() : in_pos(0), out_fd(-1), out_pos(0), out_total(0) {}
+    ~SampleFifo() { close(); }
+
+    bool openInput(const string& path) {
+        input = HostMapping::mapFile(path, false);
+        in_pos = 0;
+        if (input.base) madvise(input.base, input.size, MADV_SEQUENTIAL);
+        return input.base != nullptr;
+    }
+
+    bool openOutput(const string& path) {
+        out_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        out_ring.resize(kOutRingSamples);
+        return out_fd >= 0;
+    }
+
+    bool contains(uint32_t addr) const { return addr >= kBase && addr - kBase < kSize; }
+
+    uint32_t read32(uint32_t addr) {
+        switch (addr - kBase) {
+            case IN_DATA: {
+                if (inputLevel() == 0) return 0;
+                uint32_t sample;
+                memcpy(&sample, input.base + in_pos, sizeof(sample));
+                in_pos += sizeof(sample);
+                return sample;
+            }
+            case IN_LEVEL: return (uint32_t)min<size_t>(inputLevel(), 0xFFFFFFFFu);
+            case OUT_COUNT: return (uint32_t)out_pos;
+            default: return 0;
+        }
+    }
+
+    void write32(uint32_t addr, uint32_t value) {
+        switch (addr - kBase) {
+            case OUT_DATA:
+                if (out_fd < 0) return;
+                out_ring[out_pos++ % kOutRingSamples] = value;
+                if (out_pos - out_total >= kOutRingSamples / 2) writeBack(kOutRingSamples / 2);
+                break;
+            case CTRL:
+                if (value & 1) flush();
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Batched zero-copy input: up to max_samples samples in place in the mapping
+    const uint32_t* borrowInput(size_t max_samples, size_t& count) const {
+        count = min(max_samples, inputLevel());
+        if (!input.base) return nullptr;
+        return (const uint32_t*)(input.base + in_pos);
+    }
+
+    void consumeInput(size_t count) { in_pos += count * sizeof(uint32_t); }
+
+    void appendOutput(const uint32_t* samples, size_t count) {
+        while (count > 0 && out_fd >= 0) {
+            size_t at = out_pos % kOutRingSamples;
+            size_t room = kOutRingSamples / 2 - (out_pos - out_total);  // Until the current half fills
+            size_t n = min(count, min(room, kOutRingSamples - at));
+            memcpy(&out_ring[at], samples, n * sizeof(uint32_t));
+            out_pos += n;
+            samples += n;
+            count -= n;
+            if (out_pos - out_total >= kOutRingSamples / 2) writeBack(kOutRingSamples / 2);
+        }
+    }
+
+    void flush() {
+        if (out_fd >= 0) writeBack(out_pos - out_total);
+    }
+
+    void close() {
+        flush();
+        if (out_fd >= 0) ::close(out_fd);
+        out_fd = -1;
+        input.unmap();
+    }
+
+    size_t inputLevel() const { return input.base ? (input.size - in_pos) / sizeof(uint32_t) : 0; }
+    bool active() const { return input.base != nullptr || out_fd >= 0; }
+
+private:
+    // Write the oldest count buffered samples. This is a synchronous write on
+    // the guest thread; batching by half-rings only cuts the number of calls.
+    // A failed write closes the output and reports the buffered samples lost.
+    void writeBack(size_t count) {
+        while (count > 0 && out_fd >= 0) {
+            size_t at = out_total % kOutRingSamples;
+            size_t n = min(count, kOutRingSamples - at);
+            const char* p = (const char*)&out_ring[at];
+            size_t bytes = n * sizeof(uint32_t);
+            while (bytes > 0) {
+                ssize_t written = ::write(out_fd, p, bytes);
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) {
+                    cerr << "FIFO output write failed (" << (written < 0 ? strerror(errno) : "no progress")
+                         << "), closing it with " << (out_pos - out_total) << " buffered samples lost" << endl;
+                    ::close(out_fd);
+                    out_fd = -1;
+                    out_total = out_pos;
+                    return;
+                }
+                p += written;
+                bytes -= (size_t)written;
+            }
+            out_total += n;
+            count -= n;
+        }
+    }
+
+    HostMapping input;
+    size_t in_pos;            // Byte offset of the next input sample
+    int out_fd;
+    vector<uint32_t> out_ring;
+    size_t out_pos;           // Samples written by the guest so far
+    size_t out_total;         // Samples already written to the host file
+};
+
+// Semihosting: the reserved SWE opcode traps to the host with the operation in
+// A4 and arguments in B4, A6, B6 (C6000 calling convention); the result goes
+// back in A4. Guest writes are buffered per file and reads land directly in
+// guest memory, so the trap costs no more than a helper call.
+struct SemihostFile {
+    int host_fd = -1;
+    string out_buffer;
+};
+
+enum SemihostOp {
+    SYS_OPEN = 1,    // (path, flags) -> fd; flags 0 = read, 1 = write/create, 2 = append
+    SYS_CLOSE = 2,   // (fd)
+    SYS_WRITE = 3,   // (fd, buf, len) -> len
+    SYS_READ = 4,    // (fd, buf, len) -> bytes read
+    SYS_FLUSH = 5    // (fd)
+};
+
+// Something the cycle model has scheduled to happen at a future cycle
+enum EventKind { EVT_EDMA_COMPLETE, EVT_TIMER_MATCH, EVT_IPC_DELIVER };
+
+struct ScheduledEvent {
+    uint64_t cycle;
+    EventKind kind;
+    int arg;
+};
+
+// Cycle-ordered event scheduler: a hierarchical timing wheel with 4 levels of
+// 256 slots, covering 2^32 cycles ahead (anything further waits in an overflow
+// list). Insertion is O(1) into a pooled node, and advance() fires everything
+// up to a given cycle in order. Occupancy bitmaps let it jump straight to the
+// next slot that holds or cascades an event; outer slots are cascaded down
+// when the current cycle reaches the start of their span.
+class EventWheel {
+public:
+    static const int kLevels = 4;
+    static const int kSlotBits = 8;
+    static const int kSlots = 1 << kSlotBits;
+
+    EventWheel() : free_head(-1), current(0), pending(0) {
+        for (int l = 0; l < kLevels; l++) {
+            for (int i = 0; i < kSlots; i++) heads[l][i] = -1;
+            for (int w = 0; w < kSlots / 64; w++) occupied[l][w] = 0;
+        }
+    }
+
+    void schedule(const ScheduledEvent& ev) {
+        int node;
+        if (free_head >= 0) {
+            node = free_head;
+            free_head = nodes[node].next;
+        } else {
+            node = (int)nodes.size();
+            nodes.push_back(Node());
+        }
+        nodes[node].ev = ev;
+        if (ev.cycle < current) {
+            overdue.push_back(node);  // advance() has already passed its cycle
+        } else {
+            place(node);
+        }
+        pending++;
+    }
+
+    // Fire every event with cycle <= now, in cycle order. fire() may schedule more.
+    template <typename Fire>
+    void advance(uint64_t now, Fire&& fire) {
+        fireOverdue(fire);
+        while (current <= now) {
+            if (pending == 0) {
+                current = now + 1;
+                break;
+            }
+            if ((current & (kSlots - 1)) == 0) cascade();
+            
+            int idx = (int)(current & (kSlots - 1));
+            if (heads[0][idx] < 0) {
+                current = min(nextInteresting(), now + 1);
+                continue;
+            }
+            while (heads[0][idx] >= 0) {
+                int node = heads[0][idx];
+                heads[0][idx] = -1;
+                clearOccupied(0, idx);
+                while (node >= 0) {
+                    int following = nodes[node].next;
+                    ScheduledEvent ev = nodes[node].ev;
+                    nodes[node].next = free_head;
+                    free_head = node;
+                    pending--;
+                    fire(ev);
+                    node = following;
+                }
+            }
+            current++;
+        }
+        fireOverdue(fire);
+    }
+
+    bool empty() const { return pending == 0; }
+
+private:
+    struct Node {
+        ScheduledEvent ev;
+        int next;
+    };
+    vector<Node> nodes;
+    int free_head;
+    int heads[kLevels][kSlots];
+    uint64_t occupied[kLevels][kSlots / 64];
+    vector<int> overflow;
+    vector<int> overdue;  // Scheduled for a cycle before current
+    uint64_t current;   // Every event before this cycle has fired
+    size_t pending;
+
+    // Overdue events were due before current, so any advance() fires them
+    template <typename Fire>
+    void fireOverdue(Fire& fire) {
+        while (!overdue.empty()) {
+            vector<int> batch;
+            batch.swap(overdue);
+            stable_sort(batch.begin(), batch.end(),
+                        [this](int a, int b) { return nodes[a].ev.cycle < nodes[b].ev.cycle; });
+            for (int node : batch) {
+                ScheduledEvent ev = nodes[node].ev;
+                nodes[node].next = free_head;
+                free_head = node;
+                pending--;
+                fire(ev);
+            }
+        }
+    }
+
+    void place(int node) {
+        uint64_t cycle = max(nodes[node].ev.cycle, current);  // schedule() keeps overdue events out
+        uint64_t delta = cycle - current;
+        for (int l = 0; l < kLevels; l++) {
+            if (delta < (1ull << (kSlotBits * (l + 1)))) {
+                int idx = (int)((cycle >> (kSlotBits * l)) & (kSlots - 1));
+                nodes[node].next = heads[l][idx];
+                heads[l][idx] = node;
+                occupied[l][idx / 64] |= 1ull << (idx % 64);
+                return;
+            }
+        }
+        overflow.push_back(node);
+    }
+
+    int levelIndex(int level) const { return (int)((current >> (kSlotBits * level)) & (kSlots - 1)); }
+
+    // Re-place the outer slots whose span starts at the current cycle, outermost
+    // first so nothing cascades into a slot that has already been emptied
+    void cascade() {
+        int top = 1;
+        while (top + 1 < kLevels && levelIndex(top) == 0) top++;
+        if (top == kLevels - 1 && levelIndex(top) == 0) {
+            vector<int> far;
+            far.swap(overflow);
+            for (int node : far) place(node);
+        }
+        for (int l = top; l >= 1; l--) {
+            int idx = levelIndex(l);
+            int node = heads[l][idx];
+            heads[l][idx] = -1;
+            clearOccupied(l, idx);
+            while (node >= 0) {
+                int following = nodes[node].next;
+                place(node);
+                node = following;
+            }
+        }
+    }
+
+    // Earliest cycle at which an event fires or an outer slot cascades. A slot
+    // behind the current index belongs to the next revolution of its level.
+    uint64_t nextInteresting() const {
+        uint64_t best = ~0ull;
+        for (int l = 0; l < kLevels; l++) {
+            int shift = kSlotBits * l;
+            uint64_t span = 1ull << (shift + kSlotBits);
+            uint64_t revolution_end = (current & ~(span - 1)) + span;
+            int from = levelIndex(l) + (l == 0 ? 0 : 1);
+            int n = from < kSlots ? nextOccupied(l, from) : -1;
+            if (n >= 0) {
+                best = min(best, revolution_end - span + ((uint64_t)n << shift));
+            } else if (nextOccupied(l, 0) >= 0) {
+                best = min(best, revolution_end);
+            }
+        }
+        if (!overflow.empty()) {
+            uint64_t span = 1ull << (kSlotBits * kLevels);
+            best = min(best, (current & ~(span - 1)) + span);
+        }
+        return best;
+    }
+
+    int nextOccupied(int level, int from) const {
+        for (int w = from / 64; w < kSlots / 64; w++) {
+            uint64_t bits = occupied[level][w];
+            if (w == from / 64) bits &= ~0ull << (from % 64);
+            if (bits) return w * 64 + __builtin_ctzll(bits);
+        }
+        return -1;
+    }
+
+    void clearOccupied(int level, int idx) { occupied[level][idx / 64] &= ~(1ull << (idx % 64)); }
+};
+
+// EDMA3 channel controller PaRAM entry (hardware layout, 32 bytes)
+struct PaRAMSet {
+    uint32_t opt;
+    uint32_t src;
+    uint32_t a_b_cnt;       // BCNT[31:16] ACNT[15:0]
+    uint32_t dst;
+    uint32_t src_dst_bidx;  // DSTBIDX[31:16] SRCBIDX[15:0]
+    uint32_t link_bcntrld;  // BCNTRLD[31:16] LINK[15:0]
+    uint32_t src_dst_cidx;  // DSTCIDX[31:16] SRCCIDX[15:0]
+    uint32_t ccnt;
+};
+
+// EDMA3 transfer engine. A triggered channel moves one frame (ACNT x BCNT) for
+// AB-synchronized sets or one ACNT array for A-synchronized ones, stepping by
+// BIDX within a frame and reloading BCNT from BCNTRLD at the next; the copy and
+// its completion event land when the cycle model says the transfer is done, so
+// the core keeps executing TBs while it is in flight.
+struct Edma3 {
+    static const uint32_t kBase = 0x02700000;
+    static const uint32_t kSize = 0x8000;
+    static const uint32_t kDCHMAP = 0x0100;  // Channel -> PaRAM set
+    static const uint32_t kIER = 0x1050;
+    static const uint32_t kESR = 0x1010;     // Event set (manual trigger)
+    static const uint32_t kIPR = 0x1068;     // Transfer completion pending
+    static const uint32_t kICR = 0x1070;
+    static const uint32_t kPaRAM = 0x4000;
+    static const int kChannels = 64;
+    static const int kPaRAMSets = 512;
+    static const uint16_t kNullLink = 0xFFFF;
+    
+    // OPT fields
+    static const uint32_t kOptSyncDimAB = 1u << 2;
+    static const uint32_t kOptStatic = 1u << 3;
+    static const uint32_t kOptTcintEn = 1u << 20;
+    static const uint32_t kOptTcchEn = 1u << 22;
+    static uint32_t tcc(uint32_t opt) { return (opt >> 12) & 0x3F; }
+    
+    // Timing: startup latency plus a sustained copy rate
+    static const int kStartupCycles = 40;
+    static const int kBytesPerCycle = 16;
+    
+    array<PaRAMSet, kPaRAMSets> param;
+    array<uint16_t, kChannels> dchmap;
+    uint64_t ier = 0;
+    uint64_t ipr = 0;
+    uint64_t busy = 0;  // Channels with a transfer in flight
+    uint64_t bytes_moved = 0;
+    
+    Edma3() {
+        memset(param.data(), 0, sizeof(param));
+        for (int ch = 0; ch < kChannels; ch++) dchmap[ch] = (uint16_t)ch;
+    }
+    
+    bool contains(uint32_t addr) const { return addr >= kBase && addr - kBase < kSize; }
+    
+    static uint32_t frameBytes(const PaRAMSet& p) {
+        uint32_t acnt = p.a_b_cnt & 0xFFFF;
+        uint32_t bcnt = p.a_b_cnt >> 16;
+        return (p.opt & kOptSyncDimAB) ? acnt * bcnt : acnt;
+    }
+};
+
+// TIMER64 in 64-bit general-purpose mode. Nothing ticks: the counter is derived
+// from the global cycle count when read, and the next period match is a single
+// scheduled event. Reprogramming bumps the generation so stale events are dropped.
+struct Timer64 {
+    static const uint32_t kBase = 0x02200000;
+    static const uint32_t kSize = 0x80;
+    static const uint32_t kCNTLO = 0x10, kCNTHI = 0x14, kPRDLO = 0x18, kPRDHI = 0x1C;
+    static const uint32_t kTCR = 0x20;
+    static const int kPrescale = 6;  // Timer input clock is CPU/6
+    enum Mode { DISABLED = 0, ONE_SHOT = 1, CONTINUOUS = 2 };
+    
+    uint64_t period = 0;
+    uint64_t count_base = 0;   // Counter value at start_cycle
+    uint64_t start_cycle = 0;
+    Mode mode = DISABLED;
+    int generation = 0;
+    
+    bool contains(uint32_t addr) const { return addr >= kBase && addr - kBase < kSize; }
+    
+    uint64_t count(uint64_t now) const {
+        if (mode == DISABLED) return count_base;
+        return min(period, count_base + (now - start_cycle) / kPrescale);
+    }
+    
+    uint64_t matchCycle() const { return start_cycle + (period - count_base) * kPrescale; }
+};
+
+// C64x+ core interrupt controller: INT4-15 with IFR/IER and a global enable.
+// Flags are only sampled at TB boundaries, so nothing polls per cycle.
+struct InterruptController {
+    static const int kEdmaInt = 8;
+    static const int kTimerInt = 14;
+    static const int kIsrCycles = 20;  // Modeled cost of servicing one interrupt
+    
+    uint16_t ifr = 0;
+    uint16_t ier = 0;
+    bool gie = true;
+    array<uint64_t, 16> taken{};
+    
+    void raise(int n) { ifr |= (uint16_t)(1u << n); }
+    bool anyPending() const { return gie && (ifr & ier & 0xFFF0) != 0; }
+    int highestPending() const { return __builtin_ctz(ifr & ier & 0xFFF0); }  // Lower number wins
+};
+
+// Bounded lock-free multi-producer/single-consumer ring. Each slot carries a
+// sequence number, so producers claim slots with one CAS on the tail and the
+// consumer never touches a shared index.
+template <typename T, size_t N>
+class MpscRing {
+public:
+    MpscRing() : tail(0), head(0) {
+        for (size_t i = 0; i < N; i++) slots[i].seq.store(i, memory_order_relaxed);
+    }
+
+    bool push(const T& value) {
+        size_t pos = tail.load(memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos % N];
+            size_t seq = slot.seq.load(memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.seq.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T& value) {
+        Slot& slot = slots[head % N];
+        if (slot.seq.load(memory_order_acquire) != head + 1) return false;
+        value = slot.value;
+        slot.seq.store(head + N, memory_order_release);
+        head++;
+        return true;
+    }
+
+private:
+    struct Slot {
+        atomic<size_t> seq;
+        T value;
+    };
+    array<Slot, N> slots;
+    atomic<size_t> tail;
+    size_t head;  // Consumer only
+};
+
+// Inter-processor communication for multi-core runs: the IPCGR/IPCAR doorbell
+// registers plus a word mailbox per core. Sends go into the destination core's
+// lock-free inbound ring stamped with the sender's cycle; the receiver drains
+// its ring at TB boundaries and schedules each delivery on its own event
+// wheel, so no core ever waits for another.
+struct IpcMessage {
+    enum Kind { DOORBELL, MAILBOX };
+    uint64_t send_cycle;
+    int src_core;
+    Kind kind;
+    uint32_t value;
+};
+
+struct IpcFabric {
+    static const int kMaxCores = 8;
+    static const uint32_t kIPCGR = 0x02620240;       // Write bit 0 to interrupt core n
+    static const uint32_t kIPCAR = 0x02620280;       // Source flags, write 1 to clear
+    static const uint32_t kMailboxBase = 0x02A10000;
+    static const uint32_t kMailboxSend = 0x00;       // +0x10 * destination core
+    static const uint32_t kMailboxRecv = 0x100;      // Pop own inbox (0 if empty)
+    static const uint32_t kMailboxCount = 0x104;
+    static const uint32_t kMailboxSize = 0x200;
+    static const int kLatencyCycles = 50;
+    static const int kIpcInt = 5;
+    
+    array<MpscRing<IpcMessage, 4096>, kMaxCores> inbound;
+    atomic<uint64_t> dropped{0};  // Sends that found the destination ring full
+    
+    static bool isRegister(uint32_t addr) {
+        return (addr >= kIPCGR && addr < kIPCAR + 4 * kMaxCores) ||
+               (addr >= kMailboxBase && addr - kMailboxBase < kMailboxSize);
+    }
+};
+
+// Direct-mapped software TLB in front of the region list. Pages holding a
+// watchpoint are never filled, so only their accesses pay for the check.
+struct SoftTlb {
+    static const int kPageBits = 12;
+    static const uint32_t kPageSize = 1u << kPageBits;
+    static const uint32_t kPageMask = kPageSize - 1;
+    static const int kEntries = 256;
+    
+    struct Entry {
+        uint32_t page = ~0u;
+        uint8_t* host = nullptr;  // Host address of the page start
+        bool writable = false;
+        bool shared = false;
+    };
+    array<Entry, kEntries> entries;
+    uint64_t misses = 0;
+    
+    // Fold in higher page bits so buffers a power-of-two apart do not share a slot
+    Entry& entryFor(uint32_t page) { return entries[(page ^ (page >> 8)) % kEntries]; }
+    void flushPage(uint32_t page) {
+        if (entryFor(page).page == page) entryFor(page) = Entry();
+    }
+};
+
+// Watchpoint types follow the GDB Z packet numbering
+enum WatchType { WATCH_WRITE = 2, WATCH_READ = 3, WATCH_ACCESS = 4 };
+
+struct Watchpoint {
+    uint32_t addr;
+    uint32_t len;
+    WatchType type;
+};
+
+// Register and memory access the GDB stub needs from a simulated core. PCs are
+// EP index * 32 (one fetch packet per EP).
+class DebugTarget {
+public:
+    static const uint32_t kFetchPacketBytes = 32;
+    virtual ~DebugTarget() {}
+    virtual int debugRegisterCount() const = 0;
+    virtual uint32_t debugReadRegister(int n) = 0;
+    virtual bool debugWriteRegister(int n, uint32_t value) = 0;  // False if not writable
+    virtual bool debugReadByte(uint32_t addr, uint8_t& value) = 0;
+    virtual bool debugWriteByte(uint32_t addr, uint8_t value) = 0;
+    virtual bool debugInsert(int type, uint32_t addr, uint32_t len) = 0;
+    virtual bool debugRemove(int type, uint32_t addr, uint32_t len) = 0;
+    virtual void debugSetSingleStep(bool enable) = 0;
+};
+
+// Minimal GDB remote serial protocol server on a loopback socket. The core
+// calls serve() whenever it stops; serve() answers packets until the debugger
+// resumes (c/s) or detaches.
+class GdbStub {
+public:
+    static const int kMaxResends = 8;  // Attempts per packet while GDB NAKs it
+
+    GdbStub() : listen_fd(-1), fd(-1), running(false) {}
+    ~GdbStub() { close(); }
+
+    bool listenAndAccept(int port) {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd < 0) return false;
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(listen_fd, 1) < 0) {
+            close();
+            return false;
+        }
+        cout << "Waiting for GDB on 127.0.0.1:" << port << endl;
+        fd = accept(listen_fd, nullptr, nullptr);
+        return fd >= 0;
+    }
+
+    bool connected() const { return fd >= 0; }
+    bool killRequested() const { return killed; }
+
+    // Report a stop and handle packets until the target should run again
+    void serve(DebugTarget& target, const string& stop_reply) {
+        if (fd < 0) return;
+        if (running) sendPacket(stop_reply);  // Answers the pending c/s
+        running = false;
+        string packet;
+        while (readPacket(packet)) {
+            if (packet.empty()) continue;
+            char cmd = packet[0];
+            if (cmd == '?') {
+                sendPacket(stop_reply);
+            } else if (cmd == 'g') {
+                string out;
+                for (int n = 0; n < target.debugRegisterCount(); n++) out += hex32(target.debugReadRegister(n));
+                sendPacket(out);
+            } else if (cmd == 'p') {
+                int n = (int)strtoul(packet.c_str() + 1, nullptr, 16);
+                sendPacket(n < target.debugRegisterCount() ? hex32(target.debugReadRegister(n)) : "E01");
+            } else if (cmd == 'P') {
+                size_t eq = packet.find('=');
+                int n = (int)strtoul(packet.c_str() + 1, nullptr, 16);
+                if (eq == string::npos || n >= target.debugRegisterCount() ||
+                    !target.debugWriteRegister(n, parseHex32(packet.substr(eq + 1)))) {
+                    sendPacket("E01");
+                } else {
+                    sendPacket("OK");
+                }
+            } else if (cmd == 'm') {
+                uint32_t addr, len;
+                if (!parseAddrLen(packet.substr(1), addr, len)) { sendPacket("E01"); continue; }
+                string out;
+                uint8_t byte;
+                for (uint32_t i = 0; i < len && target.debugReadByte(addr + i, byte); i++) out += hex8(byte);
+                sendPacket(out.empty() && len ? "E14" : out);
+            } else if (cmd == 'M') {
+                size_t colon = packet.find(':');
+                uint32_t addr, len;
+                if (colon == string::npos || !parseAddrLen(packet.substr(1, colon - 1), addr, len) ||
+                    packet.size() - colon - 1 < 2 * (size_t)len) {
+                    sendPacket("E01");
+                    continue;
+                }
+                bool ok = true;
+                for (uint32_t i = 0; i < len && ok; i++) {
+                    uint8_t byte = (uint8_t)strtoul(packet.substr(colon + 1 + 2 * i, 2).c_str(), nullptr, 16);
+                    ok = target.debugWriteByte(addr + i, byte);
+                }
+                sendPacket(ok ? "OK" : "E14");
+            } else if (cmd == 'Z' || cmd == 'z') {
+                // Z<type>,<addr>,<kind/len>
+                int type = packet.size() > 1 ? packet[1] - '0' : -1;
+                uint32_t addr, len;
+                if (packet.size() < 3 || !parseAddrLen(packet.substr(3), addr, len)) { sendPacket("E01"); continue; }
+                bool ok = cmd == 'Z' ? target.debugInsert(type, addr, len) : target.debugRemove(type, addr, len);
+                sendPacket(ok ? "OK" : "");
+            } else if (cmd == 'c' || cmd == 's') {
+                target.debugSetSingleStep(cmd == 's');
+                running = true;
+                return;
+            } else if (cmd == 'D') {
+                sendPacket("OK");
+                close();
+                return;
+            } else if (cmd == 'k') {
+                killed = true;  // main() stops the run at the next phase and exits normally
+                close();
+                return;
+            } else if (packet.compare(0, 10, "qSupported") == 0) {
+                sendPacket("PacketSize=4000");
+            } else if (cmd == 'H' || packet == "qAttached") {
+                sendPacket(cmd == 'H' ? "OK" : "1");
+            } else {
+                sendPacket("");
+            }
+        }
+        close();  // Connection dropped
+    }
+
+    // Program exit
+    void exited(int code) {
+        if (fd < 0) return;
+        sendPacket("W" + hex8((uint8_t)code));
+        close();
+    }
+
+    static string hex8(uint8_t v) {
+        static const char digits[] = "0123456789abcdef";
+        return string(1, digits[v >> 4]) + digits[v & 0xF];
+    }
+
+    // Registers go over the wire in target (little-endian) byte order
+    static string hex32(uint32_t v) {
+        return hex8(v & 0xFF) + hex8((v >> 8) & 0xFF) + hex8((v >> 16) & 0xFF) + hex8(v >> 24);
+    }
+
+private:
+    int listen_fd;
+    int fd;
+    bool running;  // Debugger is waiting for a stop reply
+    bool killed = false;
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        if (listen_fd >= 0) ::close(listen_fd);
+        fd = listen_fd = -1;
+    }
+
+    static uint32_t parseHex32(const string& le) {
+        uint32_t v = 0;
+        for (size_t i = 0; i + 1 < le.size() && i < 8; i += 2) {
+            v |= (uint32_t)strtoul(le.substr(i, 2).c_str(), nullptr, 16) << (4 * i);
+        }
+        return v;
+    }
+
+    static bool parseAddrLen(const string& text, uint32_t& addr, uint32_t& len) {
+        size_t comma = text.find(',');
+        if (comma == string::npos) return false;
+        addr = (uint32_t)strtoul(text.c_str(), nullptr, 16);
+        len = (uint32_t)strtoul(text.c_str() + comma + 1, nullptr, 16);
+        return true;
+    }
+
+    bool readByte(char& c) { return ::read(fd, &c, 1) == 1; }
+
+    // NAKs a packet whose checksum does not match so GDB sends it again
+    bool readPacket(string& packet) {
+        for (;;) {
+            char c;
+            do {
+                if (!readByte(c)) return false;
+            } while (c != '$');
+            packet.clear();
+            uint8_t sum = 0;
+            while (readByte(c) && c != '#') {
+                packet += c;
+                sum += (uint8_t)c;
+            }
+            char checksum[3] = {};
+            if (!readByte(checksum[0]) || !readByte(checksum[1])) return false;
+            bool valid = isxdigit((unsigned char)checksum[0]) && isxdigit((unsigned char)checksum[1]) &&
+                         strtoul(checksum, nullptr, 16) == sum;
+            if (::write(fd, valid ? "+" : "-", 1) != 1) return false;
+            if (valid) return true;
+        }
+    }
+
+    void sendPacket(const string& data) {
+        uint8_t sum = 0;
+        for (char c : data) sum += (uint8_t)c;
+        string frame = "$" + data + "#" + hex8(sum);
+        for (int attempt = 0; attempt < kMaxResends; attempt++) {  // '-' asks for it again
+            if (::write(fd, frame.data(), frame.size()) != (ssize_t)frame.size()) return;
+            char ack;
+            if (!readByte(ack) || ack != '-') return;
+        }
+    }
+};
+
+// Predecoded interpreter. Each EP is lowered once into ops with packed register
+// numbers and immediates, followed by an end-of-EP op that advances time. The
+// register file is indexed 0-31 A0-A31, 32-63 B0-B31, then ILC, RILC and a
+// constant 1 that unconditional ops use as their predicate.
+enum ThreadedOpcode {
+    OP_NOP, OP_MVK, OP_MV, OP_ADD, OP_ADDK, OP_SUB, OP_SUBK, OP_LDW, OP_STW,
+    OP_BRANCH, OP_BRANCH_EXIT, OP_EP_END, OP_EP_END_LOOP, OP_BAIL, OP_EXIT, OP_VECTOR_LOOP, OP_SEMIHOST, OP_COUNT
+};
+
+// 8 guest iterations per host trip in vectorized SPLOOP bodies
+typedef uint32_t VectorLanes __attribute__((vector_size(32)));
+static const int kVectorLanes = 8;
+
+struct DecodedOp {
+    static const uint8_t kInRenamedBody = 1;  // Loop body with a renamed move
+    static const uint8_t kAfterRename = 2;    // Issues after the removed move
+    static const uint8_t kNoExit = 4;         // EP end that must not stop the interpreter
+    
+    const void* handler = nullptr;  // Filled in when the program is threaded
+    uint8_t opcode = OP_NOP;
+    uint8_t dst = 0, src1 = 0, src2 = 0;
+    uint8_t pred = 0;               // Predicate register (kRegOne if unconditional)
+    uint8_t pred_zero = 0;          // [!reg]
+    uint8_t delay = 0;              // Delay slots (LDW, branches)
+    uint8_t count = 0;              // EP end: guest instructions in the EP
+    uint8_t flags = 0;
+    int32_t imm = 0;                // Immediate, post-increment, or EP cycles
+    int32_t target = 0;             // Branch target / SPLOOP body EP index
+    int32_t ep = 0;                 // EP index the op belongs to
 };
 
-// Simulator state
-class VLIWSimulator {
-private:
-    vector<ExecutePacket> guest_code;
-    map<string, int> registers;
-    vector<TranslationBlock> translation_blocks;
-    vector<SavedContext> saved_contexts;
-    int current_tb_id;
-    int ILC;    // Inner Loop Counter
-    int RILC;   // Reload Inner Loop Counter
-    int state;  // State for software-pipelined loops
-    int A1;     // Outer loop counter
-    int sploop_start_index; // Index where SPLOOP starts
-    
-    // Store instruction deferred translation
-    struct DeferredStore {
-        string operands;
-        string unit;
-        int line_num;
-    };
-    vector<DeferredStore> deferred_stores;
+// Entry check for a loop optimization that reorders memory accesses. Each
+// post-incremented pointer covers [base, base + stride * iterations) from its
+// register value on entry; the check passes only if no store range overlaps
+// another range, except a load walking the same words (an in-place update).
+struct RangeGuard {
+    struct Access {
+        uint8_t base_reg;
+        int32_t stride;
+        bool write;
+    };
+    vector<Access> accesses;
+    uint64_t checks = 0;
+    uint64_t failures = 0;
+
+    void add(int base_reg, int32_t stride, bool write) {
+        accesses.push_back({(uint8_t)base_reg, stride, write});
+    }
+
+    // Lowest address and byte length of one access's range
+    static pair<int64_t, int64_t> range(const Access& a, const uint32_t* regs, uint64_t iterations) {
+        int64_t span = (int64_t)a.stride * (int64_t)iterations;
+        int64_t base = regs[a.base_reg];
+        return span >= 0 ? make_pair(base, span) : make_pair(base + span + a.stride, -span);
+    }
+
+    bool passes(const uint32_t* regs, uint64_t iterations) {
+        checks++;
+        for (size_t i = 0; i < accesses.size(); i++) {
+            if (!accesses[i].write) continue;
+            auto w = range(accesses[i], regs, iterations);
+            for (size_t j = 0; j < accesses.size(); j++) {
+                if (j == i) continue;
+                auto o = range(accesses[j], regs, iterations);
+                bool in_place = !accesses[j].write && o == w && accesses[j].stride == accesses[i].stride;
+                if (!in_place && o.first < w.first + w.second && w.first < o.first + o.second) {
+                    failures++;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+struct PredecodedProgram {
+    static const int kRegILC = 64, kRegRILC = 65, kRegOne = 66, kRegCount = 67;
+    vector<DecodedOp> ops;
+    vector<int> ep_start;           // EP index -> first op (plus the exit sentinel)
+    array<bool, kRegCount> written{};
+    vector<pair<uint8_t, uint8_t>> renamed_moves;  // dst, src of moves removed by renaming
+    
+    // Vectorized SPLOOP body: its ops without EP ends, run lane-wise
+    vector<DecodedOp> vector_ops;
+    vector<int> vector_invariants;  // Registers the body reads but never writes
+    RangeGuard vector_guard;        // Its pointers, checked over the remaining ILC
+    int vector_body_cycles = 0;
+    int vector_body_insns = 0;
+    int loop_exit_ep = -1;          // EP after SPKERNEL
+    int image = -1;
+    bool threaded = false;
+};
+
+// Host worker threads that split long independent loops. Workers sleep on a
+// futex between jobs; the calling thread takes tasks too and returns once every
+// worker has finished with the job, so nothing outlives the call.
+class HostThreadPool {
+public:
+    explicit HostThreadPool(int threads) {
+        for (int i = 1; i < threads; i++) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~HostThreadPool() {
+        stopping = true;
+        wake(generation);
+        for (auto& t : workers) t.join();
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    void parallelFor(int tasks, const function<void(int)>& fn) {
+        job = &fn;
+        job_tasks = tasks;
+        next.store(0);
+        finished.store(0);
+        wake(generation);
+        runTasks();
+        while (finished.load(memory_order_acquire) != workers.size()) this_thread::yield();
+    }
+
+private:
+    vector<thread> workers;
+    atomic<uint32_t> generation{0};
+    atomic<int> next{0};
+    atomic<size_t> finished{0};
+    const function<void(int)>* job = nullptr;
+    int job_tasks = 0;
+    atomic<bool> stopping{false};
+
+    void wake(atomic<uint32_t>& word) {
+        word.fetch_add(1, memory_order_release);
+        syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    void runTasks() {
+        for (int t; (t = next.fetch_add(1)) < job_tasks;) (*job)(t);
+    }
+
+    void workerLoop() {
+        uint32_t seen = 0;
+        for (;;) {
+            uint32_t gen;
+            while ((gen = generation.load(memory_order_acquire)) == seen) {
+                syscall(SYS_futex, (uint32_t*)&generation, FUTEX_WAIT_PRIVATE, gen, nullptr, nullptr, 0);
+            }
+            seen = gen;
+            if (stopping) return;
+            runTasks();
+            finished.fetch_add(1, memory_order_release);
+        }
+    }
+};
+
+enum InterpStatus { INTERP_BUDGET, INTERP_EXIT, INTERP_BAIL, INTERP_FAULT, INTERP_STOP };
+
+// A load result or branch still in its delay slots
+struct InterpEffect {
+    uint64_t due;     // Interpreter cycle it lands at
+    int target;       // Branch target EP, -1 for a register write, -2 to exit
+    uint8_t reg;
+    uint32_t value;
+};
+
+struct InterpResult {
+    InterpStatus status = INTERP_EXIT;
+    int ep_index = 0;               // EP to resume at (or the faulting EP)
+    uint64_t insns = 0;
+    uint64_t cycles = 0;
+    uint32_t fault_addr = 0;
+    vector<InterpEffect> pending;   // In flight at a budget or stop exit, due counted from the resume
+};
+
+// SPLOOP state saved when an interrupt arrives mid-loop. The loop buffer is
+// drained on entry and refilled on return; the kernel TB itself is untouched
+// and execution resumes in it at the saved iteration.
+struct SploopContext {
+    int kernel_tb_id;
+    int state;
+    int ILC;
+    int RILC;
+};
+
+// Host code cache layout. TBs are appended in translation order with their
+// side-exit stubs inline. compactCodeCache() relocates hot TBs and their chained
+// successors into a contiguous hot region and splits every exit stub off into
+// a cold region behind the cold bodies.
+struct CodeCache {
+    static const size_t kCapacity = 32u << 20;
+    static const int kHostBytesPerInsn = 16;
+    static const int kExitStubBytes = 24;
+    static const uint64_t kHotThreshold = 4;  // Executions before a TB counts as hot
+    int code_end = 0;
+    int hot_end = 0;      // Hot region is [0, hot_end) after compaction
+    int generation = 0;   // Bumped on every relocation or invalidation
+    HostMapping mem;      // Executable backing store
+};
+
+// Direct-mapped "last TBs by guest PC" cache consulted before the TB index on
+// every unchained exit. Entries carry the code cache generation they were
+// filled under, so a flush invalidates all of them by bumping it.
+struct JumpCache {
+    static const int kEntries = 1024;
+    struct Entry {
+        uint32_t pc = ~0u;
+        int tb_id = -1;
+        int generation = -1;
+    };
+    array<Entry, kEntries> entries;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    
+    // PCs are fetch-packet aligned, so drop the low bits
+    Entry& entryFor(uint32_t pc) { return entries[(pc >> 5) % kEntries]; }
+};
+
+// Context for saving unexpired instructions
+struct SavedContext {
+    int remaining_delay;
+    int target_sym;
+    int instruction_line;
+};
+
+// Architectural state rebuilt from the side tables when a guest access faults
+// inside an optimized TB
+struct PreciseState {
+    int ep_index = -1;
+    int line_num = -1;            // Faulting guest instruction
+    int retired = 0;              // Instructions of the EP that completed before it
+    vector<PendingResult> pending;
+    vector<int> committed_stores; // Deferred stores of the EP already performed
+    vector<int> pending_stores;   // Including the faulting one, if it is a store
+};
+
+// Symbol table for branch targets and TB labels. Names are interned while an
+// image is loaded, then a minimal perfect hash (hash-and-displace) is generated
+// so that every name maps to a dense symbol ID. Execution and translation only
+// ever see the integer IDs; the strings are kept for diagnostics.
+class LabelTable {
+private:
+    vector<string> names;      // symbol ID -> name
+    vector<int> ep_indices;    // symbol ID -> EP index (-1 if not a code address)
+    vector<int32_t> displace;  // bucket -> seed (>0) or direct slot (-(slot+1))
+    vector<int> slots;         // hash slot -> symbol ID
+    map<string, int> pending;  // names interned since the last build()
+
+    static uint32_t hash(const string& key, uint32_t seed) {
+        uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 16777619u;
+        }
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    int slotOf(const string& key) const {
+        int32_t d = displace[hash(key, 0) % displace.size()];
+        if (d < 0) return -d - 1;
+        return hash(key, (uint32_t)d) % slots.size();
+    }
+
+public:
+    // Load-time only: returns the existing ID or appends a new symbol.
+    int intern(const string& name, int ep_index = -1) {
+        int id = lookup(name);
+        if (id < 0) {
+            auto it = pending.find(name);
+            if (it != pending.end()) id = it->second;
+        }
+        if (id < 0) {
+            id = (int)names.size();
+            names.push_back(name);
+            ep_indices.push_back(ep_index);
+            pending[name] = id;
+        } else if (ep_index >= 0) {
+            ep_indices[id] = ep_index;
+        }
+        return id;
+    }
+
+    // Generate the perfect hash over all interned names. Buckets are placed
+    // largest first; single-key buckets take the remaining slots directly.
+    void build() {
+        size_t n = names.size();
+        pending.clear();
+        slots.assign(n, -1);
+        displace.assign(n / 4 + 1, 0);
+        if (n == 0) return;
+
+        vector<vector<int>> buckets(displace.size());
+        for (size_t id = 0; id < n; id++) {
+            buckets[hash(names[id], 0) % buckets.size()].push_back((int)id);
+        }
+        vector<int> order(buckets.size());
+        for (size_t b = 0; b < order.size(); b++) order[b] = (int)b;
+        stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        size_t free_cursor = 0;
+        vector<int> placed;
+        for (int b : order) {
+            const vector<int>& keys = buckets[b];
+            if (keys.empty()) break;
+            if (keys.size() == 1) {
+                while (slots[free_cursor] != -1) free_cursor++;
+                slots[free_cursor] = keys[0];
+                displace[b] = -(int32_t)free_cursor - 1;
+                continue;
+            }
+            for (uint32_t seed = 1;; seed++) {
+                placed.clear();
+                for (int id : keys) {
+                    int s = hash(names[id], seed) % n;
+                    if (slots[s] != -1 || find(placed.begin(), placed.end(), s) != placed.end()) break;
+                    placed.push_back(s);
+                }
+                if (placed.size() == keys.size()) {
+                    for (size_t k = 0; k < keys.size(); k++) slots[placed[k]] = keys[k];
+                    displace[b] = (int32_t)seed;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Load-time only: -1 if the name is unknown or the hash is stale.
+    int lookup(const string& name) const {
+        if (slots.empty()) return -1;
+        int id = slots[slotOf(name)];
+        return (id >= 0 && names[id] == name) ? id : -1;
+    }
+
+    void define(int id, int ep_index) { ep_indices[id] = ep_index; }
+    int epIndex(int id) const { return id >= 0 ? ep_indices[id] : -1; }
+    const string& name(int id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+// Simulator state
+class VLIWSimulator : public DebugTarget {
+private:
+    vector<ExecutePacket> guest_code;
+    map<string, int> registers;
+    vector<TranslationBlock> translation_blocks;
+    vector<SavedContext> saved_contexts;
+    int current_tb_id;
+    int core_id = 0;
+    uint64_t shared_accesses = 0;  // Shared-region accesses, read by the sync barrier
+    uint64_t global_cycle = 0;
+    EventWheel events;
+    int ILC;    // Inner Loop Counter
+    int RILC;   // Reload Inner Loop Counter
+    int state;  // State for software-pipelined loops
+    int A1;     // Outer loop counter
+    int sploop_start_index; // Index where SPLOOP starts
+    int active_kernel_tb = -1;  // Kernel TB of the SPLOOP being executed, if any
+    vector<SploopContext> sploop_save_stack;
+    
+    // Branch targets and TB labels, resolved to IDs at load time
+    LabelTable symbols;
+    vector<int> tb_by_label;  // label symbol ID -> TB ID (-1 if not translated)
+    CodeCache code_cache;
+    unordered_map<uint32_t, int> tb_index;  // Guest PC -> TB of the current image
+    JumpCache jump_cache;
+    
+    // Guest memory map, devices and host I/O
+    SimOptions options;
+    vector<MemoryRegion> memory_regions;
+    SampleFifo sample_fifo;
+    Edma3 edma;
+    Timer64 timer;
+    InterruptController intc;
+    IpcFabric* ipc = nullptr;      // Set for multi-core runs
+    uint32_t ipcar = 0;
+    deque<uint32_t> mailbox;       // Delivered mailbox words
+    vector<IpcMessage> ipc_in_flight;
+    vector<int> ipc_free_slots;
+    vector<IpcMessage> ipc_staged;  // Popped, but sent after the current quantum began
+    uint64_t ipc_delivered = 0;
+    uint64_t ipc_latency_total = 0;
+    uint64_t kernel_runs = 0;      // Kernel iterations across quanta, paces IPC sends
+    vector<SemihostFile> semihost_files;  // Guest fd -> host file
+    static const size_t kSemihostBufferBytes = 64u << 10;
+    
+    // Cycle budget, charged a TB's static cost on entry. A TB that does not fit
+    // is finished EP by EP and may be left part-way until the next budget.
+    int64_t cycle_budget = 0;
+    int partial_tb = -1;
+    int partial_pos = 0;       // Next EP of the partial TB
+    int partial_nop_left = 0;  // Cycles left of a split multi-cycle NOP
+    uint64_t slow_path_eps = 0;
+    
+    // Guest register caching across chained TBs. A chain group's hottest guest
+    // registers live in callee-saved host registers: they are filled on an
+    // unchained entry, written back on an unchained exit or before a helper
+    // that reads guest state, and never touched at chained transitions.
+    static const int kHostRegs = 6;
+    int last_tb = -1;
+    int live_group = -1;
+    bitset<PredecodedProgram::kRegCount> dirty_regs;
+    uint64_t reg_fills = 0, reg_spills = 0;
+    uint64_t reg_boundary_accesses = 0;   // Loads/stores of uncached registers
+    uint64_t reg_uncached_baseline = 0;   // Same without any caching
+    int sym_loop_state_0, sym_loop_state_1;
+    int sym_nested_state_0, sym_nested_state_1, sym_nested_state_2;
+    int current_image = 0;     // Bumped each time a guest image is loaded
+    
+    // Tiering: SPLOOP kernels start in the interpreter and are entered on-stack
+    static const int kOsrThreshold = 32;  // Interpreted iterations before OSR
+    uint64_t interpreted_eps = 0;
+    uint64_t osr_entries = 0;
+    PredecodedProgram predecoded;
+    uint32_t interp_regs[PredecodedProgram::kRegCount] = {};
+    bool rename_kernel_moves = true;
+    bool vectorize_sploop = true;
+    uint64_t vector_iterations = 0;
+    
+    static const int kDeoptThreshold = 4;          // Guard failures before a site stops assuming
+    map<pair<uint32_t, int>, int> guard_failures;  // (site PC, SpecKind) -> failures
+    map<uint32_t, uint32_t> spec_disabled;         // Site PC -> SpecKind bits no longer assumed
+    uint64_t deopts = 0;
+    uint64_t spec_retranslations = 0;
+    
+    // Value profiling of selected registers at TB entry (off unless asked for)
+    bool value_profiling = false;
+    vector<string> profiled_regs;
+    static const int kStableValueRuns = 16;
+    uint64_t value_specializations = 0;
+    uint64_t folded_operands = 0;
+    static const uint64_t kParallelMinTrips = 1 << 15;  // 256K iterations
+    int host_threads = 0;
+    unique_ptr<HostThreadPool> host_pool;
+    uint64_t parallel_trips = 0;
+    static const int kMaxDelayedEffects = 32;
+    
+    // Debugging
+    SoftTlb tlb;
+    vector<int> breakpoints;   // EP indices in the current image
+    vector<Watchpoint> watchpoints;
+    GdbStub* gdb = nullptr;
+    bool stop_pending = false; // Set by a watchpoint hit, reported at the TB boundary
+    string stop_reply;
+    int stop_ep = 0;
+    bool single_step = false;
+    
+    // Store instruction deferred translation
+    struct DeferredStore {
+        string operands;
+        string unit;
+        int line_num;
+    };
+    vector<DeferredStore> deferred_stores;
+
+public:
+    explicit VLIWSimulator(const SimOptions& opts = SimOptions())
+        : current_tb_id(0), ILC(0), RILC(0), state(0), A1(0), sploop_start_index(-1), options(opts) {
+        registers["B1"] = 5;
+        registers["B3"] = 0;
+        registers["A10"] = 100;
+        registers["A2"] = 0;
+        registers["A4"] = 0;
+        
+        sym_loop_state_0 = symbols.intern("LOOP_STATE_0");
+        sym_loop_state_1 = symbols.intern("LOOP_STATE_1");
+        sym_nested_state_0 = symbols.intern("NESTED_STATE_0");
+        sym_nested_state_1 = symbols.intern("NESTED_STATE_1");
+        sym_nested_state_2 = symbols.intern("NESTED_STATE_2");
+        resolveSymbols();
+        
+        code_cache.mem = HostMapping::map(CodeCache::kCapacity, true, options.huge_pages);
+        mapGuestRegion("L2SRAM", 0x00800000, 1u << 20);
+        mapGuestRegion("DDR3", 0x80000000, options.ddr_size);
+        if (!options.ddr_file.empty()) {
+            mapGuestFile("DDR3 capture", options.ddr_file_base, options.ddr_file, options.ddr_file_cow);
+        }
+        if (!options.fifo_in.empty() && !sample_fifo.openInput(options.fifo_in)) {
+            cout << "Failed to open FIFO input " << options.fifo_in << endl;
+        }
+        if (!options.fifo_out.empty() && !sample_fifo.openOutput(options.fifo_out)) {
+            cout << "Failed to open FIFO output " << options.fifo_out << endl;
+        }
+        
+        semihost_files.resize(3);
+        for (int fd = 0; fd < 3; fd++) semihost_files[fd].host_fd = fd;
+        host_threads = options.host_threads;
+    }
+
+    ~VLIWSimulator() {
+        for (size_t fd = 0; fd < semihost_files.size(); fd++) {
+            semihostFlush((int)fd);
+            if (fd > 2 && semihost_files[fd].host_fd >= 0) ::close(semihost_files[fd].host_fd);
+        }
+        for (auto& region : memory_regions) {
+            if (region.owned) region.host.unmap();
+        }
+        code_cache.mem.unmap();
+    }
+
+    VLIWSimulator(const VLIWSimulator&) = delete;
+    VLIWSimulator& operator=(const VLIWSimulator&) = delete;
+
+    // A new region must stay inside the 32-bit guest space and clear of the
+    // regions already mapped, or findRegion would pick whichever came first
+    bool regionFits(const string& name, uint32_t guest_base, uint64_t size) {
+        if (size == 0 || guest_base + size > 0x100000000ull) {
+            cout << "Cannot map " << name << ": " << (size >> 10) << " KB at 0x" << hex << guest_base << dec
+                 << " runs past the 4 GB guest address space" << endl;
+            return false;
+        }
+        for (const auto& other : memory_regions) {
+            if (guest_base < other.guest_base + (uint64_t)other.size && other.guest_base < guest_base + size) {
+                cout << "Cannot map " << name << ": overlaps " << other.name << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool mapGuestRegion(const string& name, uint32_t guest_base, size_t size) {
+        if (!regionFits(name, guest_base, size)) return false;
+        MemoryRegion region;
+        region.name = name;
+        region.guest_base = guest_base;
+        region.size = size;
+        region.writable = true;
+        region.host = HostMapping::map(size, false, options.huge_pages);
+        if (!region.host.base) {
+            cout << "Failed to map " << name << " (" << (size >> 10) << " KB)" << endl;
+            return false;
+        }
+        memory_regions.push_back(region);
+        return true;
+    }
+
+    bool mapGuestFile(const string& name, uint32_t guest_base, const string& path, bool copy_on_write) {
+        MemoryRegion region;
+        region.name = name;
+        region.guest_base = guest_base;
+        region.writable = copy_on_write;
+        region.host = HostMapping::mapFile(path, copy_on_write);
+        if (!region.host.base) {
+            cout << "Failed to map " << path << " into " << name << endl;
+            return false;
+        }
+        // The region cannot extend past the top of the 32-bit guest address space
+        region.size = min<uint64_t>(region.host.size, 0x100000000ull - guest_base);
+        if (!regionFits(name, guest_base, region.size)) {
+            region.host.unmap();
+            return false;
+        }
+        memory_regions.push_back(region);
+        return true;
+    }
+
+    // Map memory owned by the multi-core runner (MSMC) into this core
+    void attachSharedRegion(const string& name, uint32_t guest_base, const HostMapping& host) {
+        if (!regionFits(name, guest_base, host.size)) return;
+        MemoryRegion region;
+        region.name = name;
+        region.guest_base = guest_base;
+        region.size = host.size;
+        region.writable = true;
+        region.host = host;
+        region.shared = true;
+        region.owned = false;
+        memory_regions.push_back(region);
+    }
+
+    // Host address backing [addr, addr + len), or nullptr if unmapped (or
+    // read-only when a store is requested)
+    uint8_t* hostAddress(uint32_t addr, size_t len, bool write = false) {
+        uint32_t page = addr >> SoftTlb::kPageBits;
+        const SoftTlb::Entry& e = tlb.entryFor(page);
+        if (e.page == page && (addr & SoftTlb::kPageMask) + len <= SoftTlb::kPageSize && (e.writable || !write)) {
+            if (e.shared) shared_accesses++;
+            return e.host + (addr & SoftTlb::kPageMask);
+        }
+        return hostAddressSlow(addr, len, write);
+    }
+
+    // TLB miss: check watchpoints, walk the regions and refill the entry unless
+    // the page is being watched
+    uint8_t* hostAddressSlow(uint32_t addr, size_t len, bool write) {
+        tlb.misses++;
+        bool watched_page = false;
+        uint32_t page = addr >> SoftTlb::kPageBits;
+        for (const auto& wp : watchpoints) {
+            if ((wp.addr >> SoftTlb::kPageBits) <= page && page <= ((wp.addr + wp.len - 1) >> SoftTlb::kPageBits)) {
+                watched_page = true;
+            }
+            bool type_match = wp.type == WATCH_ACCESS || (wp.type == WATCH_WRITE) == write;
+            if (type_match && addr < wp.addr + wp.len && wp.addr < addr + len) {
+                watchpointHit(wp, addr);
+            }
+        }
+        
+        MemoryRegion* region = findRegion(addr, len);
+        if (!region || (write && !region->writable)) return nullptr;
+        if (region->shared) shared_accesses++;
+        
+        uint64_t page_offset = ((uint64_t)page << SoftTlb::kPageBits) - region->guest_base;
+        if (!watched_page && ((uint64_t)page << SoftTlb::kPageBits) >= region->guest_base &&
+            page_offset + SoftTlb::kPageSize <= region->size) {
+            SoftTlb::Entry& e = tlb.entryFor(page);
+            e.page = page;
+            e.host = region->host.base + page_offset;
+            e.writable = region->writable;
+            e.shared = region->shared;
+        }
+        return region->host.base + (addr - region->guest_base);
+    }
+
+    MemoryRegion* findRegion(uint32_t addr, size_t len) {
+        for (auto& region : memory_regions) {
+            uint64_t offset = (uint64_t)addr - region.guest_base;
+            if (addr >= region.guest_base && offset + len <= region.size) return &region;
+        }
+        return nullptr;
+    }
+
+    // 32-bit guest data accesses: peripherals first, then RAM. Return false on a fault.
+    bool guestLoad32(uint32_t addr, uint32_t& value) {
+        if (sample_fifo.contains(addr)) {
+            value = sample_fifo.read32(addr);
+            return true;
+        }
+        if (edma.contains(addr)) {
+            value = edmaRead32(addr - Edma3::kBase);
+            return true;
+        }
+        if (timer.contains(addr)) {
+            value = timerRead32(addr - Timer64::kBase);
+            return true;
+        }
+        if (ipc && IpcFabric::isRegister(addr)) {
+            value = ipcRead32(addr);
+            return true;
+        }
+        uint8_t* p = hostAddress(addr, sizeof(value));
+        if (!p) return false;
+        memcpy(&value, p, sizeof(value));
+        return true;
+    }
+
+    bool guestStore32(uint32_t addr, uint32_t value) {
+        if (sample_fifo.contains(addr)) {
+            sample_fifo.write32(addr, value);
+            return true;
+        }
+        if (edma.contains(addr)) {
+            edmaWrite32(addr - Edma3::kBase, value);
+            return true;
+        }
+        if (timer.contains(addr)) {
+            timerWrite32(addr - Timer64::kBase, value);
+            return true;
+        }
+        if (ipc && IpcFabric::isRegister(addr)) {
+            ipcWrite32(addr, value);
+            return true;
+        }
+        uint8_t* p = hostAddress(addr, sizeof(value), true);
+        if (!p) return false;
+        memcpy(p, &value, sizeof(value));
+        return true;
+    }
+
+    // Handle one semihosting trap. Returns the value the guest sees in A4.
+    int32_t semihostCall(uint32_t op, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+        switch (op) {
+            case SYS_OPEN: {
+                string path;
+                for (uint32_t addr = arg0; path.size() < 4096; addr++) {
+                    uint8_t* c = hostAddress(addr, 1);
+                    if (!c || *c == 0) break;
+                    path += (char)*c;
+                }
+                int flags = arg1 == 0 ? O_RDONLY
+                          : arg1 == 1 ? (O_WRONLY | O_CREAT | O_TRUNC)
+                                      : (O_WRONLY | O_CREAT | O_APPEND);
+                int host_fd = ::open(path.c_str(), flags, 0644);
+                if (host_fd < 0) return -1;
+                SemihostFile file;
+                file.host_fd = host_fd;
+                semihost_files.push_back(file);
+                return (int32_t)semihost_files.size() - 1;
+            }
+            case SYS_CLOSE: {
+                if (!validSemihostFd(arg0) || arg0 <= 2) return -1;
+                semihostFlush((int)arg0);
+                ::close(semihost_files[arg0].host_fd);
+                semihost_files[arg0].host_fd = -1;
+                return 0;
+            }
+            case SYS_WRITE: {
+                uint8_t* buf = hostAddress(arg1, arg2);
+                if (!validSemihostFd(arg0) || !buf) return -1;
+                SemihostFile& file = semihost_files[arg0];
+                file.out_buffer.append((const char*)buf, arg2);
+                if (file.out_buffer.size() >= kSemihostBufferBytes) semihostFlush((int)arg0);
+                return (int32_t)arg2;
+            }
+            case SYS_READ: {
+                uint8_t* buf = hostAddress(arg1, arg2, true);
+                if (!validSemihostFd(arg0) || !buf) return -1;
+                semihostFlush((int)arg0);
+                ssize_t n = ::read(semihost_files[arg0].host_fd, buf, arg2);
+                return n < 0 ? -1 : (int32_t)n;
+            }
+            case SYS_FLUSH:
+                if (!validSemihostFd(arg0)) return -1;
+                semihostFlush((int)arg0);
+                return 0;
+            default:
+                return -1;
+        }
+    }
+
+    bool validSemihostFd(uint32_t fd) const {
+        return fd < semihost_files.size() && semihost_files[fd].host_fd >= 0;
+    }
+
+    void semihostFlush(int fd) {
+        SemihostFile& file = semihost_files[fd];
+        if (file.out_buffer.empty() || file.host_fd < 0) return;
+        if (file.host_fd <= 2) cout.flush();  // Keep ordering with the simulator's own output
+        const char* p = file.out_buffer.data();
+        size_t bytes = file.out_buffer.size();
+        while (bytes > 0) {
+            ssize_t n = ::write(file.host_fd, p, bytes);
+            if (n <= 0) break;
+            p += n;
+            bytes -= (size_t)n;
+        }
+        file.out_buffer.clear();
+    }
+
+    void executeSemihostTrap() {
+        registers["A4"] = semihostCall(registers["A4"], registers["B4"], registers["A6"], registers["B6"]);
+    }
+
+    // Trap for every SWE in one EP of a TB
+    void trapSemihostCalls(const ExecutePacket& ep) {
+        for (const auto& insn : ep.instructions) {
+            if (insn.type == SEMIHOST) executeSemihostTrap();
+        }
+    }
+
+    void printMemoryMap() {
+        cout << "Guest memory map:" << endl;
+        for (const auto& region : memory_regions) {
+            cout << "  " << region.name << " @0x" << hex << setw(8) << setfill('0') << region.guest_base
+                 << dec << setfill(' ') << " (" << (region.size >> 10) << " KB, "
+                 << HostMapping::backingName(region.host.backing) << ")" << endl;
+        }
+        cout << "  Code cache (" << (code_cache.mem.size >> 10) << " KB, "
+             << HostMapping::backingName(code_cache.mem.backing) << ")" << endl;
+        if (sample_fifo.active()) {
+            cout << "  Sample FIFO @0x" << hex << SampleFifo::kBase << dec << " ("
+                 << sample_fifo.inputLevel() << " input samples)" << endl;
+        }
+    }
+
+    // Drain the input capture through the FIFO registers, scaling each sample,
+    // the way a guest streaming kernel would.
+    void streamSamples() {
+        cout << "\n=== Streaming Sample FIFO ===" << endl;
+        uint32_t level = 0, sample = 0, written = 0;
+        uint64_t processed = 0;
+        guestLoad32(SampleFifo::kBase + SampleFifo::IN_LEVEL, level);
+        while (level > 0) {
+            guestLoad32(SampleFifo::kBase + SampleFifo::IN_DATA, sample);
+            guestStore32(SampleFifo::kBase + SampleFifo::OUT_DATA, sample << 1);
+            processed++;
+            guestLoad32(SampleFifo::kBase + SampleFifo::IN_LEVEL, level);
+        }
+        guestStore32(SampleFifo::kBase + SampleFifo::CTRL, 1);
+        guestLoad32(SampleFifo::kBase + SampleFifo::OUT_COUNT, written);
+        cout << "Processed " << processed << " samples, " << written << " written to output" << endl;
+    }
+
+    Instruction createInstruction(InsnType type, const string& mnemonic, const string& unit,
+                                   int delay, const string& operands, int line, 
+                                   const string& pred = "", bool par = false) {
+        Instruction insn;
+        insn.type = type;
+        insn.mnemonic = mnemonic;
+        insn.unit = unit;
+        insn.delay_slots = delay;
+        insn.operands = operands;
+        insn.line_num = line;
+        insn.predicate = pred;
+        insn.parallel = par;
+        return insn;
+    }
+
+    void addEP(int ep_num, int cycles, const Instruction& insn) {
+        ExecutePacket ep;
+        ep.ep_num = ep_num;
+        ep.cycles = cycles;
+        ep.instructions.push_back(insn);
+        guest_code.push_back(ep);
+    }
+
+    void addEP(int ep_num, int cycles, const vector<Instruction>& insns) {
+        ExecutePacket ep;
+        ep.ep_num = ep_num;
+        ep.cycles = cycles;
+        ep.instructions = insns;
+        guest_code.push_back(ep);
+    }
+
+    // Load-time pass: intern every branch target of the current image, build the
+    // perfect hash and stamp the resulting symbol IDs into the instructions.
+    void resolveSymbols() {
+        for (auto& ep : guest_code) {
+            for (auto& insn : ep.instructions) {
+                if (insn.type == BRANCH) {
+                    symbols.intern(branchTargetName(insn));
+                }
+            }
+        }
+        symbols.build();
+        current_image++;
+        tb_index.clear();
+        code_cache.generation++;  // Drops jump cache entries of the previous image
+        for (auto& ep : guest_code) {
+            for (auto& insn : ep.instructions) {
+                if (insn.type == BRANCH) {
+                    insn.target_sym = symbols.lookup(branchTargetName(insn));
+                }
+            }
+        }
+        tb_by_label.resize(symbols.size(), -1);
+    }
+
+    // Target is the last operand token ("LOOP", "B3", "BR TARGET" -> "TARGET")
+    static string branchTargetName(const Instruction& insn) {
+        size_t pos = insn.operands.find_last_of(' ');
+        return pos == string::npos ? insn.operands : insn.operands.substr(pos + 1);
+    }
+
+    void registerTB(const TranslationBlock& tb) {
+        translation_blocks.push_back(tb);
+        TranslationBlock& added = translation_blocks.back();
+        if (added.image == 0) added.image = current_image;
+        if (!breakpoints.empty() && added.image == current_image) {
+            added.trap_eps.clear();
+            for (int bp : breakpoints) {
+                if (tbCoversEP(added, bp)) added.trap_eps.push_back(bp);
+            }
+        }
+        if (tb.label_sym >= 0) {
+            tb_by_label[tb.label_sym] = tb.tb_id;
+        }
+        if (added.image == current_image && !added.packets.empty()) {
+            auto it = tb_index.find(tbGuestPC(added));
+            if (it == tb_index.end() || !translation_blocks[it->second].valid) {
+                tb_index[tbGuestPC(added)] = added.tb_id;
+            }
+        }
+        
+        // Emit in translation order with the exit stubs inline
+        TranslationBlock& placed = translation_blocks.back();
+        placed.host_size = 0;
+        placed.exit_stubs = 1;
+        placed.semihost_traps = 0;
+        placed.cycle_cost = 0;
+        for (const auto& ep : placed.packets) {
+            placed.cycle_cost += ep.cycles;
+            placed.host_size += (int)ep.instructions.size() * CodeCache::kHostBytesPerInsn;
+            for (const auto& insn : ep.instructions) {
+                if (insn.type == BRANCH) placed.exit_stubs++;
+                if (insn.type == SEMIHOST) placed.semihost_traps++;
+            }
+        }
+        placed.host_offset = code_cache.code_end;
+        placed.stub_offset = placed.host_offset + placed.host_size;
+        code_cache.code_end = placed.stub_offset + placed.exit_stubs * CodeCache::kExitStubBytes;
+        emitTB(placed);
+        buildStateMap(placed);
+        computeRegisterUse(placed);
+    }
+
+    void computeRegisterUse(TranslationBlock& tb) {
+        bitset<PredecodedProgram::kRegCount> reads, writes, live_in;
+        vector<int> r, w;
+        for (const auto& ep : tb.packets) {
+            bitset<PredecodedProgram::kRegCount> ep_writes;
+            for (const auto& insn : ep.instructions) {
+                DecodedOp op;
+                if (!decodeInstruction(insn, 0, op)) continue;
+                opRegisters(op, r, w);
+                if (op.opcode == OP_LDW) w.push_back(op.dst);
+                for (int reg : r) {
+                    reads.set(reg);
+                    if (!writes[reg]) live_in.set(reg);  // EP operands are read in parallel
+                }
+                for (int reg : w) ep_writes.set(reg);
+            }
+            writes |= ep_writes;
+        }
+        reads.reset(PredecodedProgram::kRegOne);
+        live_in.reset(PredecodedProgram::kRegOne);
+        tb.reg_reads.clear();
+        tb.reg_writes.clear();
+        tb.live_in.clear();
+        for (int reg = 0; reg < PredecodedProgram::kRegCount; reg++) {
+            if (reads[reg]) tb.reg_reads.push_back(reg);
+            if (writes[reg]) tb.reg_writes.push_back(reg);
+            if (live_in[reg]) tb.live_in.push_back(reg);
+        }
+    }
+
+    // Give the TBs connected to tb_id by chain links one register allocation:
+    // the kHostRegs guest registers with the most profile-weighted uses
+    void allocateChainRegisters(int tb_id) {
+        vector<int> group = {tb_id};
+        vector<bool> seen(translation_blocks.size(), false);
+        seen[tb_id] = true;
+        for (size_t i = 0; i < group.size(); i++) {
+            for (const auto& tb : translation_blocks) {
+                const TranslationBlock& cur = translation_blocks[group[i]];
+                bool linked = tb.chain_next == cur.tb_id || cur.chain_next == tb.tb_id;
+                if (linked && tb.valid && !seen[tb.tb_id]) {
+                    seen[tb.tb_id] = true;
+                    group.push_back(tb.tb_id);
+                }
+            }
+        }
+        
+        vector<uint64_t> weight(PredecodedProgram::kRegCount, 0);
+        for (int id : group) {
+            const TranslationBlock& tb = translation_blocks[id];
+            for (int reg : tb.reg_reads) weight[reg] += tb.exec_count + 1;
+            for (int reg : tb.reg_writes) weight[reg] += tb.exec_count + 1;
+        }
+        vector<int> order;
+        for (int reg = 0; reg < PredecodedProgram::kRegCount; reg++) {
+            if (weight[reg]) order.push_back(reg);
+        }
+        stable_sort(order.begin(), order.end(), [&](int a, int b) { return weight[a] > weight[b]; });
+        if ((int)order.size() > kHostRegs) order.resize(kHostRegs);
+        
+        for (int id : group) {
+            translation_blocks[id].reg_group = group.front();
+            translation_blocks[id].cached_regs = order;
+        }
+        if (live_group == group.front()) {
+            writeBackCachedRegisters();
+            live_group = -1;  // Refill under the new allocation
+        }
+    }
+
+    static string guestRegisterName(int reg) {
+        if (reg == PredecodedProgram::kRegILC) return "ILC";
+        if (reg == PredecodedProgram::kRegRILC) return "RILC";
+        return (reg < 32 ? "A" : "B") + to_string(reg % 32);
+    }
+
+    // Before a helper that reads guest state; the values stay in host registers
+    void writeBackCachedRegisters() {
+        reg_spills += dirty_regs.count();
+        dirty_regs.reset();
+    }
+
+    // Register traffic at TB entry: chained transitions within a group keep
+    // the cached registers; anything else spills the old group and fills this one
+    void enterTBRegisters(const TranslationBlock& tb) {
+        bool chained = last_tb >= 0 && tb.reg_group >= 0 && tb.reg_group == live_group &&
+                       (translation_blocks[last_tb].chain_next == tb.tb_id ||
+                        (last_tb == tb.tb_id && active_kernel_tb == tb.tb_id));
+        if (!chained) {
+            writeBackCachedRegisters();
+            live_group = tb.reg_group;
+            reg_fills += tb.cached_regs.size();
+        }
+        auto cached = [&](int reg) {
+            return find(tb.cached_regs.begin(), tb.cached_regs.end(), reg) != tb.cached_regs.end();
+        };
+        for (int reg : tb.reg_reads) {
+            if (!cached(reg)) reg_boundary_accesses++;
+        }
+        for (int reg : tb.reg_writes) {
+            if (cached(reg)) dirty_regs.set(reg);
+            else reg_boundary_accesses++;
+        }
+        reg_uncached_baseline += tb.reg_reads.size() + tb.reg_writes.size();
+        last_tb = tb.tb_id;
+    }
+
+    // Record, for every host instruction, the guest instruction it came from in
+    // emitted order, and the delay-slot results in flight at each EP start. This
+    // is all a fault needs, so the TB itself never commits state per instruction.
+    static void buildStateMap(TranslationBlock& tb) {
+        tb.state_map.clear();
+        tb.pending_results.clear();
+        tb.pending_begin.clear();
+        vector<PendingResult> in_flight;
+        if (tb.kernel_loop) in_flight = loopCarriedResults(tb);
+        for (int pos = 0; pos < (int)tb.packets.size(); pos++) {
+            const ExecutePacket& ep = tb.packets[pos];
+            tb.pending_begin.push_back((int)tb.pending_results.size());
+            tb.pending_results.insert(tb.pending_results.end(), in_flight.begin(), in_flight.end());
+            
+            for (int pass = 0; pass < 2; pass++) {  // Stores deferred to the end of the EP
+                for (int i = 0; i < (int)ep.instructions.size(); i++) {
+                    if ((ep.instructions[i].type == STORE) == (pass == 1)) {
+                        tb.state_map.push_back(StateMapEntry{pos, i});
+                    }
+                }
+            }
+            
+            advanceInFlight(in_flight, ep);
+        }
+        tb.pending_begin.push_back((int)tb.pending_results.size());
+    }
+
+    // Results a kernel TB inherits from its previous iteration, once the loop
+    // has run long enough for the iteration boundary state to stop changing
+    static vector<PendingResult> loopCarriedResults(const TranslationBlock& tb) {
+        vector<PendingResult> in_flight;
+        for (int pass = 0; pass < 16; pass++) {
+            vector<PendingResult> next = in_flight;
+            for (const auto& ep : tb.packets) advanceInFlight(next, ep);
+            bool same = next.size() == in_flight.size();
+            for (size_t i = 0; same && i < next.size(); i++) {
+                same = next[i].instruction_line == in_flight[i].instruction_line &&
+                       next[i].remaining_delay == in_flight[i].remaining_delay;
+            }
+            if (same) break;
+            in_flight = next;
+        }
+        return in_flight;
+    }
+
+    // Age the results in flight by one EP and add the ones it issues
+    static void advanceInFlight(vector<PendingResult>& in_flight, const ExecutePacket& ep) {
+        for (auto& result : in_flight) result.remaining_delay -= ep.cycles;
+        in_flight.erase(remove_if(in_flight.begin(), in_flight.end(),
+                                  [](const PendingResult& r) { return r.remaining_delay <= 0; }),
+                        in_flight.end());
+        for (const auto& insn : ep.instructions) {
+            if ((insn.type == BRANCH || insn.type == LOAD) && insn.delay_slots > 0) {
+                in_flight.push_back(PendingResult{insn.delay_slots, insn.line_num, insn.type == BRANCH});
+            }
+        }
+    }
+
+    // Rebuild the guest state at a host instruction position inside a TB
+    PreciseState reconstructState(const TranslationBlock& tb, int host_pos) const {
+        PreciseState st;
+        if (host_pos < 0 || host_pos >= (int)tb.state_map.size()) return st;
+        const StateMapEntry& at = tb.state_map[host_pos];
+        const ExecutePacket& ep = tb.packets[at.ep_pos];
+        st.ep_index = ep.ep_num - 1;
+        st.line_num = ep.instructions[at.insn].line_num;
+        st.pending.assign(tb.pending_results.begin() + tb.pending_begin[at.ep_pos],
+                          tb.pending_results.begin() + tb.pending_begin[at.ep_pos + 1]);
+        for (int pos = host_pos; pos >= 0 && tb.state_map[pos].ep_pos == at.ep_pos; pos--) {
+            const Instruction& insn = ep.instructions[tb.state_map[pos].insn];
+            if (pos == host_pos) {
+                if (insn.type == STORE) st.pending_stores.push_back(insn.line_num);
+            } else {
+                st.retired++;
+                if (insn.type == STORE) st.committed_stores.insert(st.committed_stores.begin(), insn.line_num);
+            }
+        }
+        for (int pos = host_pos + 1; pos < (int)tb.state_map.size() && tb.state_map[pos].ep_pos == at.ep_pos; pos++) {
+            const Instruction& insn = ep.instructions[tb.state_map[pos].insn];
+            if (insn.type == STORE) st.pending_stores.push_back(insn.line_num);
+        }
+        return st;
+    }
+
+    // A guest access faulted at host_pc inside a TB's body: rebuild the precise
+    // state from the side tables and stop there with SIGSEGV
+    void guestFault(int tb_id, int host_pc, uint32_t addr) {
+        const TranslationBlock& tb = translation_blocks[tb_id];
+        int host_pos = (host_pc - tb.host_offset) / CodeCache::kHostBytesPerInsn;
+        PreciseState st = reconstructState(tb, host_pos);
+        cout << "  Guest fault at 0x" << hex << addr << dec << " in TB" << tb_id << " (host +"
+             << (host_pc - tb.host_offset) << "): EP" << (st.ep_index + 1) << ", line " << st.line_num
+             << ", " << st.retired << " instruction(s) of the EP retired" << endl;
+        for (const auto& r : st.pending) {
+            cout << "    In flight: " << (r.branch ? "branch" : "load") << " from line " << r.instruction_line
+                 << ", " << r.remaining_delay << " delay slot(s) left" << endl;
+        }
+        for (int line : st.committed_stores) cout << "    Store from line " << line << " committed" << endl;
+        for (int line : st.pending_stores) cout << "    Store from line " << line << " not performed" << endl;
+        
+        stop_ep = st.ep_index;
+        stop_reply = "S0b";
+        enterDebugger();
+    }
+
+    static uint32_t tbGuestPC(const TranslationBlock& tb) {
+        return (uint32_t)(tb.packets.front().ep_num - 1) * kFetchPacketBytes;
+    }
+
+    // TB for a guest PC on an unchained exit: the jump cache first, then the
+    // TB index. -1 if nothing is translated there yet.
+    int lookupTB(uint32_t pc) {
+        JumpCache::Entry& e = jump_cache.entryFor(pc);
+        if (e.pc == pc && e.generation == code_cache.generation) {
+            jump_cache.hits++;
+            return e.tb_id;
+        }
+        jump_cache.misses++;
+        auto it = tb_index.find(pc);
+        if (it == tb_index.end()) return -1;
+        e.pc = pc;
+        e.tb_id = it->second;
+        e.generation = code_cache.generation;
+        return it->second;
+    }
+
+    void executeTB(int tb_id) {
+        runTBBody(translation_blocks[enterTB(tb_id)]);
+    }
+
+    // TB entry shared by whole and budgeted execution: follow retranslations,
+    // profile or speculate, trap breakpoints and set up cached registers.
+    // Returns the TB that actually runs.
+    int enterTB(int tb_id) {
+        while (!translation_blocks[tb_id].valid) {
+            tb_id = translation_blocks[tb_id].replaced_by;  // Patched entry of a retranslated TB
+        }
+        if (value_profiling && translation_blocks[tb_id].specialized < 0 && translation_blocks[tb_id].generic_tb < 0) {
+            profileValues(tb_id);
+        }
+        if (translation_blocks[tb_id].specialized >= 0) {
+            tb_id = enterSpeculation(tb_id);
+        }
+        TranslationBlock& tb = translation_blocks[tb_id];
+        if (!tb.trap_eps.empty()) {
+            breakpointTrap(tb);
+        }
+        enterTBRegisters(tb);
+        return tb_id;
+    }
+
+    // Everything of an entered TB in one step
+    void runTBBody(TranslationBlock& tb) {
+        tb.exec_count++;
+        if (tb.semihost_traps) {
+            for (const auto& ep : tb.packets) trapSemihostCalls(ep);
+        }
+        global_cycle += tb.cycle_cost;
+        leaveTB(tb.packets.empty() ? 0 : tb.packets.back().ep_num);
+    }
+
+    // Events, interrupts and debugger stops due once execution pauses before
+    // next_ep, whether a TB ended there or a cycle budget did
+    void leaveTB(int next_ep) {
+        serviceEvents();
+        if (intc.anyPending()) {
+            takeInterrupt();
+        }
+        if (stop_pending || single_step) {
+            if (single_step) {
+                stop_ep = next_ep;
+                stop_reply = "S05";
+            }
+            enterDebugger();
+        }
+    }
+
+    // Fast path of budgeted execution: one compare and subtract per TB.
+    // Returns false once the budget is used up; a TB that has not been
+    // entered yet starts on the fast path again under the next budget.
+    bool runTBBudgeted(int tb_id) {
+        if (cycle_budget <= 0) return false;
+        TranslationBlock& tb = translation_blocks[enterTB(tb_id)];
+        if (tb.cycle_cost <= cycle_budget) {
+            cycle_budget -= tb.cycle_cost;
+            runTBBody(tb);
+            return true;
+        }
+        partial_tb = tb.tb_id;
+        partial_pos = 0;
+        partial_nop_left = 0;
+        return finishPartialTB();
+    }
+
+    // Slow path: step the partial TB EP by EP while the budget lasts. A
+    // multi-cycle NOP can be split; any other EP runs only if it fits whole.
+    // A TB still parked before its first EP goes whole once it fits.
+    bool finishPartialTB() {
+        bool replaced = false;
+        while (!translation_blocks[partial_tb].valid) {
+            partial_tb = translation_blocks[partial_tb].replaced_by;
+            replaced = true;
+        }
+        TranslationBlock& tb = translation_blocks[partial_tb];
+        if (partial_pos == 0 && partial_nop_left == 0) {
+            if (replaced && !tb.trap_eps.empty()) {
+                breakpointTrap(tb);  // Retranslated with a breakpoint while parked
+            }
+            if (tb.cycle_cost <= cycle_budget) {
+                cycle_budget -= tb.cycle_cost;
+                partial_tb = -1;
+                runTBBody(tb);
+                return true;
+            }
+        }
+        while (partial_pos < (int)tb.packets.size()) {
+            const ExecutePacket& ep = tb.packets[partial_pos];
+            int left = partial_nop_left ? partial_nop_left : ep.cycles;
+            if (left > cycle_budget) {
+                bool nop_only = all_of(ep.instructions.begin(), ep.instructions.end(),
+                                       [](const Instruction& insn) { return insn.type == NOP; });
+                if (nop_only && cycle_budget > 0) {
+                    partial_nop_left = left - (int)cycle_budget;
+                    global_cycle += cycle_budget;
+                    cycle_budget = 0;
+                }
+                break;
+            }
+            if (tb.semihost_traps) trapSemihostCalls(ep);
+            global_cycle += left;
+            cycle_budget -= left;
+            partial_nop_left = 0;
+            partial_pos++;
+            slow_path_eps++;
+        }
+        
+        bool done = partial_pos == (int)tb.packets.size();
+        int next_ep = done ? tb.packets.back().ep_num : tb.packets[partial_pos].ep_num - 1;
+        if (done) {
+            tb.exec_count++;
+            partial_tb = -1;
+        }
+        leaveTB(next_ep);
+        return done;
+    }
+
+    // Guest PC after a TB falls through; the end of the image branches to LOOP
+    uint32_t fallThroughPC(int tb_id) const {
+        int next_ep = translation_blocks[tb_id].packets.back().ep_num;
+        return next_ep < (int)guest_code.size() ? next_ep * kFetchPacketBytes : 0;
+    }
+
+    // ---- Debugging ----
+
+    void attachDebugger(GdbStub* stub) { gdb = stub; }
+
+    // Report a stop: hand control to GDB if attached, otherwise just log it
+    void enterDebugger() {
+        stop_pending = false;
+        if (gdb && gdb->connected()) {
+            gdb->serve(*this, stop_reply);
+        } else {
+            cout << "    Debug stop at EP" << (stop_ep + 1) << " (" << stop_reply << ")" << endl;
+        }
+    }
+
+    void breakpointTrap(const TranslationBlock& tb) {
+        stop_ep = tb.trap_eps.front();
+        stop_reply = "S05";
+        cout << "    Breakpoint at EP" << (stop_ep + 1) << " trapped in TB" << tb.tb_id << endl;
+        enterDebugger();
+    }
+
+    void watchpointHit(const Watchpoint& wp, uint32_t addr) {
+        static const char* kinds[] = {"", "", "watch", "rwatch", "awatch"};
+        ostringstream reply;
+        reply << "T05" << kinds[wp.type] << ":" << hex << setw(8) << setfill('0') << addr << ";";
+        stop_reply = reply.str();
+        stop_pending = true;
+        cout << "    Watchpoint hit at 0x" << hex << addr << dec << endl;
+    }
+
+    static bool tbCoversEP(const TranslationBlock& tb, int ep_index) {
+        for (const auto& ep : tb.packets) {
+            if (ep.ep_num - 1 == ep_index) return true;
+        }
+        return false;
+    }
+
+    // Invalidate every live TB of the current image that contains the EP and
+    // retranslate it with the traps that now apply; nothing else is touched.
+    // TBs translated later pick their traps up in registerTB.
+    void retranslateForBreakpoints(int ep_index) {
+        size_t count = translation_blocks.size();
+        for (size_t id = 0; id < count; id++) {
+            TranslationBlock& old_tb = translation_blocks[id];
+            if (!old_tb.valid || old_tb.image != current_image || !tbCoversEP(old_tb, ep_index)) continue;
+            if (old_tb.generic_tb >= 0) continue;  // Invalidated with its generic TB below
+            
+            TranslationBlock tb = old_tb;
+            tb.tb_id = current_tb_id++;
+            tb.exec_count = 0;
+            tb.specialized = -1;  // Traps go into generic code only
+            tb.trap_eps.clear();  // Recomputed by registerTB
+            old_tb.valid = false;
+            old_tb.replaced_by = tb.tb_id;
+            if (old_tb.specialized >= 0) {
+                translation_blocks[old_tb.specialized].valid = false;
+                translation_blocks[old_tb.specialized].replaced_by = tb.tb_id;
+            }
+            for (auto& other : translation_blocks) {
+                if (other.chain_next == (int)id) other.chain_next = tb.tb_id;
+            }
+            registerTB(tb);
+            code_cache.generation++;  // Jump cache entries may name the stale TB
+            cout << "  Invalidated TB" << id << ", retranslated as TB" << tb.tb_id
+                 << (translation_blocks.back().trap_eps.empty() ? " without traps" : " with trap") << endl;
+        }
+    }
+
+    // ---- Speculation and deoptimization ----
+    
+    int specValue(const SpecGuard& guard) {
+        if (guard.kind == SPEC_ILC) return ILC;
+        auto it = registers.find(guard.reg);
+        return it == registers.end() ? 0 : it->second;
+    }
+    
+    bool guardHolds(const SpecGuard& guard) {
+        int value = specValue(guard);
+        return guard.kind == SPEC_PREDICATE ? (value != 0) == (guard.expected != 0) : value == guard.expected;
+    }
+    
+    // Rewrite the TB body under one assumption; false if nothing changed. A
+    // known predicate drops the instructions it disables and the test from
+    // those it enables, up to and including the EP that writes the register.
+    bool applySpeculation(TranslationBlock& tb, const SpecGuard& guard) {
+        if (guard.kind != SPEC_PREDICATE) return false;
+        int guard_reg = parseRegister(guard.reg);
+        bool changed = false;
+        for (auto& ep : tb.packets) {
+            vector<Instruction> kept;
+            bool written = false;
+            for (auto& insn : ep.instructions) {
+                written = written || writesRegister(insn, guard_reg);
+                bool negate = insn.predicate.size() > 1 && insn.predicate[1] == '!';
+                string reg = insn.predicate.empty() ? "" :
+                             insn.predicate.substr(negate ? 2 : 1, insn.predicate.size() - (negate ? 3 : 2));
+                if (reg != guard.reg) {
+                    kept.push_back(insn);
+                    continue;
+                }
+                changed = true;
+                if ((guard.expected != 0) != negate) {
+                    kept.push_back(insn);
+                    kept.back().predicate.clear();
+                }
+            }
+            ep.instructions = kept;
+            if (written) break;  // Later EPs see the new value
+        }
+        return changed;
+    }
+    
+    // Whether the instruction writes the register, now or after its delay slots
+    bool writesRegister(const Instruction& insn, int reg) {
+        DecodedOp op;
+        vector<int> reads, writes;
+        if (decodeInstruction(insn, 0, op)) {
+            opRegisters(op, reads, writes);
+            if (op.opcode == OP_LDW) writes.push_back(op.dst);
+            return find(writes.begin(), writes.end(), reg) != writes.end();
+        }
+        vector<string> ops = splitOperands(insn.operands);
+        return !ops.empty() && parseRegister(ops.back()) == reg;
+    }
+    
+    // Translate a specialization of a generic TB under the guards its site
+    // still speculates on. Guards that leave the body as it was are not kept.
+    // Returns the TB to run there: the specialization, or the generic TB if
+    // nothing is left to assume.
+    int specializeTB(int generic_id, const vector<SpecGuard>& guards) {
+        uint32_t disabled = spec_disabled[tbGuestPC(translation_blocks[generic_id])];
+        TranslationBlock tb = translation_blocks[generic_id];
+        tb.guards.clear();
+        bool values = false;
+        for (const auto& guard : guards) {
+            if (disabled & (1u << guard.kind)) continue;
+            if (guard.kind == SPEC_VALUE) {
+                tb.guards.push_back(guard);
+                values = true;
+            } else if (applySpeculation(tb, guard)) {
+                tb.guards.push_back(guard);
+            }
+        }
+        if (values) {
+            uint64_t folded = folded_operands;
+            foldValueGuards(tb);
+            if (folded_operands == folded) {
+                tb.guards.erase(remove_if(tb.guards.begin(), tb.guards.end(),
+                                          [](const SpecGuard& g) { return g.kind == SPEC_VALUE; }),
+                                tb.guards.end());
+            }
+        }
+        translation_blocks[generic_id].specialized = -1;
+        if (tb.guards.empty()) return generic_id;
+        
+        tb.tb_id = current_tb_id++;
+        tb.label_sym = -1;  // Reached only through the generic TB
+        tb.exec_count = 0;
+        tb.chain_next = -1;
+        tb.generic_tb = generic_id;
+        tb.specialized = -1;
+        registerTB(tb);
+        translation_blocks[generic_id].specialized = tb.tb_id;
+        return tb.tb_id;
+    }
+    
+    // Propagate the values the guards pin through the TB and fold them in:
+    // known predicates resolve, MV of a constant becomes MVK, ADD/SUB take an
+    // immediate (or become MVK), and post-increments keep known pointers known.
+    // Constants are folded only where they fit the field (signed 16 bits for
+    // MVK, 5 bits for ADD/SUB); a value that does not fit is still tracked.
+    // Loaded registers stay unknown for the rest of the TB.
+    void foldValueGuards(TranslationBlock& tb) {
+        const int kRegOne = PredecodedProgram::kRegOne;
+        array<bool, PredecodedProgram::kRegCount> known{}, poisoned{};
+        array<int32_t, PredecodedProgram::kRegCount> value{};
+        for (const auto& guard : tb.guards) {
+            int reg = parseRegister(guard.reg);
+            if (guard.kind != SPEC_VALUE || reg < 0) continue;
+            known[reg] = true;
+            value[reg] = guard.expected;
+        }
+        
+        for (auto& ep : tb.packets) {
+            vector<Instruction> kept;
+            vector<pair<int, int64_t>> updates;  // Register, value (or unknown)
+            const int64_t kUnknown = INT64_MIN;
+            for (Instruction insn : ep.instructions) {
+                DecodedOp op;
+                if (!decodeInstruction(insn, 0, op)) {
+                    vector<string> ops = splitOperands(insn.operands);
+                    int dst = ops.empty() ? -1 : parseRegister(ops.back());
+                    if (dst >= 0) updates.push_back({dst, kUnknown});
+                    kept.push_back(insn);
+                    continue;
+                }
+                if (op.pred != kRegOne && known[op.pred]) {
+                    if ((value[op.pred] != 0) == (op.pred_zero != 0)) {
+                        folded_operands++;
+                        continue;  // Never executes
+                    }
+                    insn.predicate.clear();
+                    op.pred = kRegOne;
+                    folded_operands++;
+                }
+                bool conditional = op.pred != kRegOne;
+                string dst = guestRegisterName(op.dst);
+                auto fits = [](int64_t v, int bits) { return v >= -(1LL << (bits - 1)) && v < (1LL << (bits - 1)); };
+                auto constant = [&](int64_t v) {
+                    if (fits(v, 16)) {
+                        insn.mnemonic = "MVK";
+                        insn.operands = to_string((int32_t)v) + ", " + dst;
+                        folded_operands++;
+                    }
+                    updates.push_back({op.dst, conditional ? kUnknown : (int32_t)v});
+                };
+                switch (op.opcode) {
+                    case OP_MV:
+                        if (known[op.src1] && insn.mnemonic == "MV") constant(value[op.src1]);
+                        else updates.push_back({op.dst, kUnknown});
+                        break;
+                    case OP_MVK:
+                        updates.push_back({op.dst, conditional ? kUnknown : op.imm});
+                        break;
+                    case OP_ADD: case OP_SUB: {
+                        bool add = op.opcode == OP_ADD;
+                        if (known[op.src1] && known[op.src2]) {
+                            constant(add ? (int64_t)value[op.src1] + value[op.src2] : (int64_t)value[op.src1] - value[op.src2]);
+                        } else if (known[op.src2] && fits(value[op.src2], 5)) {
+                            insn.operands = guestRegisterName(op.src1) + ", " + to_string(value[op.src2]) + ", " + dst;
+                            folded_operands++;
+                            updates.push_back({op.dst, kUnknown});
+                        } else if (known[op.src1] && add && fits(value[op.src1], 5)) {
+                            insn.operands = guestRegisterName(op.src2) + ", " + to_string(value[op.src1]) + ", " + dst;
+                            folded_operands++;
+                            updates.push_back({op.dst, kUnknown});
+                        } else {
+                            updates.push_back({op.dst, kUnknown});
+                        }
+                        break;
+                    }
+                    case OP_ADDK: case OP_SUBK:
+                        if (known[op.src1]) constant(op.opcode == OP_ADDK ? (int64_t)value[op.src1] + op.imm
+                                                                          : (int64_t)value[op.src1] - op.imm);
+                        else updates.push_back({op.dst, kUnknown});
+                        break;
+                    case OP_LDW: case OP_STW:
+                        if (op.opcode == OP_LDW) poisoned[op.dst] = true;
+                        updates.push_back({op.src1, known[op.src1] && !conditional ? (int64_t)value[op.src1] + op.imm
+                                                                                   : kUnknown});
+                        break;
+                    default:
+                        break;
+                }
+                kept.push_back(insn);
+            }
+            ep.instructions = kept;
+            for (const auto& update : updates) {
+                known[update.first] = update.second != kUnknown && !poisoned[update.first];
+                value[update.first] = (int32_t)update.second;
+            }
+            for (int reg = 0; reg < PredecodedProgram::kRegCount; reg++) {
+                if (poisoned[reg]) known[reg] = false;
+            }
+        }
+    }
+    
+    // Entry profile of the selected live-in registers; once they hold the
+    // same values for kStableValueRuns entries, specialize on them
+    void profileValues(int tb_id) {
+        TranslationBlock& tb = translation_blocks[tb_id];
+        auto disabled = spec_disabled.find(tbGuestPC(tb));
+        if (disabled != spec_disabled.end() && (disabled->second & (1u << SPEC_VALUE))) return;
+        if (!tb.profiled) {
+            tb.profiled = true;
+            for (int reg : tb.live_in) {
+                string name = guestRegisterName(reg);
+                if (find(profiled_regs.begin(), profiled_regs.end(), name) != profiled_regs.end()) {
+                    tb.value_profile.push_back(ValueProfile{name});
+                }
+            }
+        }
+        if (tb.value_profile.empty()) return;
+        
+        vector<SpecGuard> stable;
+        for (auto& profile : tb.value_profile) {
+            auto it = registers.find(profile.reg);
+            int32_t v = it == registers.end() ? 0 : it->second;
+            if (profile.runs > 0 && v == profile.value) {
+                profile.runs++;
+            } else {
+                profile.value = v;
+                profile.runs = 1;
+            }
+            if (profile.runs >= kStableValueRuns) stable.push_back({SPEC_VALUE, profile.reg, v});
+        }
+        if (stable.empty()) return;
+        for (auto& profile : tb.value_profile) profile.runs = 0;
+        if (specializeTB(tb_id, stable) != tb_id) value_specializations++;
+    }
+    
+    // Guards run before the TB touches any guest state, so a failure leaves
+    // the state precise at TB entry and the generic TB simply runs instead
+    int enterSpeculation(int generic_id) {
+        int spec_id = translation_blocks[generic_id].specialized;
+        for (const auto& guard : translation_blocks[spec_id].guards) {
+            if (guardHolds(guard)) continue;
+            deopts++;
+            uint32_t pc = tbGuestPC(translation_blocks[generic_id]);
+            if (++guard_failures[{pc, guard.kind}] >= kDeoptThreshold) {
+                // Stop assuming this at the site and retranslate without it
+                spec_disabled[pc] |= 1u << guard.kind;
+                vector<SpecGuard> remaining = translation_blocks[spec_id].guards;
+                translation_blocks[spec_id].valid = false;
+                translation_blocks[spec_id].replaced_by = generic_id;
+                specializeTB(generic_id, remaining);
+                spec_retranslations++;
+            }
+            return generic_id;
+        }
+        return spec_id;
+    }
+
+    bool setBreakpoint(int ep_index) {
+        if (ep_index < 0) return false;
+        if (find(breakpoints.begin(), breakpoints.end(), ep_index) != breakpoints.end()) return true;
+        breakpoints.push_back(ep_index);
+        retranslateForBreakpoints(ep_index);
+        return true;
+    }
+
+    bool removeBreakpoint(int ep_index) {
+        auto it = find(breakpoints.begin(), breakpoints.end(), ep_index);
+        if (it == breakpoints.end()) return false;
+        breakpoints.erase(it);
+        retranslateForBreakpoints(ep_index);
+        return true;
+    }
+
+    bool setWatchpoint(uint32_t addr, uint32_t len, WatchType type) {
+        if (len == 0) return false;
+        watchpoints.push_back(Watchpoint{addr, len, type});
+        for (uint32_t page = addr >> SoftTlb::kPageBits; page <= (addr + len - 1) >> SoftTlb::kPageBits; page++) {
+            tlb.flushPage(page);
+        }
+        return true;
+    }
+
+    bool removeWatchpoint(uint32_t addr, uint32_t len, WatchType type) {
+        for (auto it = watchpoints.begin(); it != watchpoints.end(); ++it) {
+            if (it->addr == addr && it->len == len && it->type == type) {
+                watchpoints.erase(it);
+                return true;  // The page refills on its next access
+            }
+        }
+        return false;
+    }
+
+    // DebugTarget: A0-A31, B0-B31, then PC
+    int debugRegisterCount() const override { return 65; }
+
+    string debugRegisterName(int n) const {
+        return (n < 32 ? "A" : "B") + to_string(n % 32);
+    }
+
+    uint32_t debugReadRegister(int n) override {
+        if (n == 64) return (uint32_t)stop_ep * kFetchPacketBytes;
+        auto it = registers.find(debugRegisterName(n));
+        return it == registers.end() ? 0 : (uint32_t)it->second;
+    }
+
+    // The PC is read-only: the demos, not the guest, decide what runs next
+    bool debugWriteRegister(int n, uint32_t value) override {
+        if (n >= 64) return false;
+        registers[debugRegisterName(n)] = (int)value;
+        return true;
+    }
+
+    bool debugReadByte(uint32_t addr, uint8_t& value) override {
+        MemoryRegion* region = findRegion(addr, 1);
+        if (!region) return false;
+        value = region->host.base[addr - region->guest_base];
+        return true;
+    }
+
+    bool debugWriteByte(uint32_t addr, uint8_t value) override {
+        MemoryRegion* region = findRegion(addr, 1);
+        if (!region || !region->writable) return false;
+        region->host.base[addr - region->guest_base] = value;
+        return true;
+    }
+
+    bool debugInsert(int type, uint32_t addr, uint32_t len) override {
+        if (type == 0 || type == 1) return setBreakpoint((int)(addr / kFetchPacketBytes));
+        if (type >= WATCH_WRITE && type <= WATCH_ACCESS) return setWatchpoint(addr, len, (WatchType)type);
+        return false;
+    }
+
+    bool debugRemove(int type, uint32_t addr, uint32_t len) override {
+        if (type == 0 || type == 1) return removeBreakpoint((int)(addr / kFetchPacketBytes));
+        if (type >= WATCH_WRITE && type <= WATCH_ACCESS) return removeWatchpoint(addr, len, (WatchType)type);
+        return false;
+    }
+
+    void debugSetSingleStep(bool enable) override { single_step = enable; }
+
+    void takeInterrupt() {
+        int n = intc.highestPending();
+        intc.ifr &= (uint16_t)~(1u << n);
+        intc.taken[n]++;
+        uint64_t start = global_cycle;
+        writeBackCachedRegisters();  // The ISR sees guest registers in memory
+        
+        // Mid-SPLOOP: drain the loop buffer and save the loop state so the ISR
+        // may run its own loops
+        bool in_sploop = active_kernel_tb >= 0 && ILC > 0;
+        if (in_sploop) {
+            SploopContext ctx = {active_kernel_tb, state, ILC, RILC};
+            sploop_save_stack.push_back(ctx);
+            global_cycle += translation_blocks[active_kernel_tb].cycle_cost;
+            active_kernel_tb = -1;
+            state = 0;
+        }
+        
+        global_cycle += InterruptController::kIsrCycles;
+        
+        if (in_sploop) {
+            SploopContext ctx = sploop_save_stack.back();
+            sploop_save_stack.pop_back();
+            active_kernel_tb = ctx.kernel_tb_id;
+            state = ctx.state;
+            ILC = ctx.ILC;
+            RILC = ctx.RILC;
+            global_cycle += translation_blocks[active_kernel_tb].cycle_cost;  // Refill
+            cout << "    INT" << n << " taken during SPLOOP: drained, saved state=" << ctx.state
+                 << " ILC=" << ctx.ILC << " RILC=" << ctx.RILC << ", resuming TB" << ctx.kernel_tb_id
+                 << " without retranslation" << endl;
+        }
+        cycle_budget -= (int64_t)(global_cycle - start);  // ISRs are atomic and may overrun a budget
+    }
+
+    void scheduleEvent(uint64_t cycle, EventKind kind, int arg) {
+        events.schedule(ScheduledEvent{cycle, kind, arg});
+    }
+
+    // Batch-run everything due in the cycle span of the TB that just executed
+    void serviceEvents() {
+        events.advance(global_cycle, [this](const ScheduledEvent& ev) { dispatchEvent(ev); });
+    }
+
+    void dispatchEvent(const ScheduledEvent& ev) {
+        switch (ev.kind) {
+            case EVT_EDMA_COMPLETE:
+                edmaComplete(ev.arg);
+                break;
+            case EVT_TIMER_MATCH:
+                timerMatch(ev.cycle, ev.arg);
+                break;
+            case EVT_IPC_DELIVER:
+                ipcDeliver(ev.arg);
+                break;
+        }
+    }
+
+    void ipcSend(int dst_core, IpcMessage::Kind kind, uint32_t value) {
+        if (dst_core >= IpcFabric::kMaxCores) return;
+        IpcMessage msg = {global_cycle, core_id, kind, value};
+        if (!ipc->inbound[dst_core].push(msg)) {
+            ipc->dropped.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    // Move mail sent up to sent_by from the inbound ring onto this core's event
+    // wheel. Called once per quantum with the quantum's start, so what a core
+    // sees never depends on how far the sender's thread has run; later sends
+    // wait in ipc_staged. Mail whose delivery cycle has already passed fires at
+    // the next service point, so skew is bounded by the quantum.
+    void drainIpc(uint64_t sent_by) {
+        IpcMessage msg;
+        while (ipc->inbound[core_id].pop(msg)) ipc_staged.push_back(msg);
+        stable_sort(ipc_staged.begin(), ipc_staged.end(), [](const IpcMessage& a, const IpcMessage& b) {
+            return a.send_cycle != b.send_cycle ? a.send_cycle < b.send_cycle : a.src_core < b.src_core;
+        });
+        size_t kept = 0;
+        for (const IpcMessage& staged : ipc_staged) {
+            if (staged.send_cycle > sent_by) {
+                ipc_staged[kept++] = staged;
+                continue;
+            }
+            msg = staged;
+            int slot;
+            if (!ipc_free_slots.empty()) {
+                slot = ipc_free_slots.back();
+                ipc_free_slots.pop_back();
+                ipc_in_flight[slot] = msg;
+            } else {
+                slot = (int)ipc_in_flight.size();
+                ipc_in_flight.push_back(msg);
+            }
+            scheduleEvent(msg.send_cycle + IpcFabric::kLatencyCycles, EVT_IPC_DELIVER, slot);
+        }
+        ipc_staged.resize(kept);
+    }
+
+    void ipcDeliver(int slot) {
+        const IpcMessage& msg = ipc_in_flight[slot];
+        if (msg.kind == IpcMessage::DOORBELL) {
+            ipcar |= (msg.value & ~0xFu) ? (msg.value & ~0xFu) : (1u << (4 + msg.src_core));
+            intc.raise(IpcFabric::kIpcInt);
+        } else {
+            mailbox.push_back(msg.value);
+        }
+        ipc_delivered++;
+        ipc_latency_total += global_cycle - msg.send_cycle;
+        ipc_free_slots.push_back(slot);
+    }
+
+    uint32_t ipcRead32(uint32_t addr) {
+        if (addr == IpcFabric::kIPCAR + 4 * (uint32_t)core_id) return ipcar;
+        if (addr == IpcFabric::kMailboxBase + IpcFabric::kMailboxCount) return (uint32_t)mailbox.size();
+        if (addr == IpcFabric::kMailboxBase + IpcFabric::kMailboxRecv) {
+            if (mailbox.empty()) return 0;
+            uint32_t value = mailbox.front();
+            mailbox.pop_front();
+            return value;
+        }
+        return 0;
+    }
+
+    void ipcWrite32(uint32_t addr, uint32_t value) {
+        if (addr >= IpcFabric::kIPCGR && addr < IpcFabric::kIPCAR) {
+            if (value & 1) ipcSend((addr - IpcFabric::kIPCGR) / 4, IpcMessage::DOORBELL, value);
+        } else if (addr == IpcFabric::kIPCAR + 4 * (uint32_t)core_id) {
+            ipcar &= ~value;
+        } else if (addr >= IpcFabric::kMailboxBase && addr < IpcFabric::kMailboxBase + IpcFabric::kMailboxRecv) {
+            ipcSend((addr - IpcFabric::kMailboxBase) / 0x10, IpcMessage::MAILBOX, value);
+        }
+    }
+
+    void timerStart(uint64_t from_count) {
+        timer.generation++;
+        timer.count_base = from_count;
+        timer.start_cycle = global_cycle;
+        if (timer.mode != Timer64::DISABLED && timer.period > 0) {
+            scheduleEvent(timer.matchCycle(), EVT_TIMER_MATCH, timer.generation);
+        }
+    }
+
+    void timerMatch(uint64_t cycle, int generation) {
+        if (generation != timer.generation) return;  // Timer was reprogrammed
+        intc.raise(InterruptController::kTimerInt);
+        if (timer.mode == Timer64::CONTINUOUS) {
+            timer.count_base = 0;
+            timer.start_cycle = cycle;
+            scheduleEvent(timer.matchCycle(), EVT_TIMER_MATCH, generation);
+        } else {
+            timer.count_base = timer.period;
+            timer.mode = Timer64::DISABLED;
+        }
+    }
+
+    uint32_t timerRead32(uint32_t offset) {
+        switch (offset) {
+            case Timer64::kCNTLO: return (uint32_t)timer.count(global_cycle);
+            case Timer64::kCNTHI: return (uint32_t)(timer.count(global_cycle) >> 32);
+            case Timer64::kPRDLO: return (uint32_t)timer.period;
+            case Timer64::kPRDHI: return (uint32_t)(timer.period >> 32);
+            case Timer64::kTCR: return (uint32_t)timer.mode << 6;
+            default: return 0;
+        }
+    }
+
+    void timerWrite32(uint32_t offset, uint32_t value) {
+        uint64_t now = timer.count(global_cycle);
+        switch (offset) {
+            case Timer64::kCNTLO: now = (now & ~0xFFFFFFFFull) | value; break;
+            case Timer64::kCNTHI: now = (now & 0xFFFFFFFFull) | ((uint64_t)value << 32); break;
+            case Timer64::kPRDLO: timer.period = (timer.period & ~0xFFFFFFFFull) | value; break;
+            case Timer64::kPRDHI: timer.period = (timer.period & 0xFFFFFFFFull) | ((uint64_t)value << 32); break;
+            case Timer64::kTCR: timer.mode = (Timer64::Mode)((value >> 6) & 3); break;
+            default: return;
+        }
+        timerStart(now);
+    }
+
+    // Start a transfer on a channel; the data moves when it completes
+    void edmaTrigger(int channel) {
+        uint64_t bit = 1ull << channel;
+        if (edma.busy & bit) return;  // Already in flight; real hardware would flag a missed event
+        const PaRAMSet& p = edma.param[edma.dchmap[channel]];
+        uint32_t bytes = Edma3::frameBytes(p);
+        if (bytes == 0 || p.ccnt == 0) return;
+        edma.busy |= bit;
+        uint64_t duration = Edma3::kStartupCycles + (bytes + Edma3::kBytesPerCycle - 1) / Edma3::kBytesPerCycle;
+        scheduleEvent(global_cycle + duration, EVT_EDMA_COMPLETE, channel);
+    }
+
+    // Copy one array, with the FIFO data registers served in bulk from its buffers
+    void edmaCopy(uint32_t dst, uint32_t src, uint32_t bytes) {
+        if (sample_fifo.contains(src)) {
+            size_t count = 0;
+            const uint32_t* samples = sample_fifo.borrowInput(bytes / 4, count);
+            uint8_t* d = hostAddress(dst, count * 4, true);
+            if (d && samples) memcpy(d, samples, count * 4);
+            sample_fifo.consumeInput(count);
+        } else if (sample_fifo.contains(dst)) {
+            uint8_t* s = hostAddress(src, bytes);
+            if (s) sample_fifo.appendOutput((const uint32_t*)s, bytes / 4);
+        } else {
+            uint8_t* s = hostAddress(src, bytes);
+            uint8_t* d = hostAddress(dst, bytes, true);
+            if (s && d) memmove(d, s, bytes);
+        }
+        edma.bytes_moved += bytes;
+    }
+
+    void edmaComplete(int channel) {
+        edma.busy &= ~(1ull << channel);
+        PaRAMSet& p = edma.param[edma.dchmap[channel]];
+        uint32_t acnt = p.a_b_cnt & 0xFFFF;
+        uint32_t bcnt = p.a_b_cnt >> 16;
+        int16_t src_bidx = (int16_t)(p.src_dst_bidx & 0xFFFF);
+        int16_t dst_bidx = (int16_t)(p.src_dst_bidx >> 16);
+        int16_t src_cidx = (int16_t)(p.src_dst_cidx & 0xFFFF);
+        int16_t dst_cidx = (int16_t)(p.src_dst_cidx >> 16);
+        
+        bool last;
+        if (!(p.opt & Edma3::kOptSyncDimAB)) {
+            // One array per event: step by BIDX within the frame; after the
+            // frame's last array, CIDX (from that array) leads to the next frame
+            edmaCopy(p.dst, p.src, acnt);
+            last = p.ccnt == 1 && bcnt <= 1;
+            if (!(p.opt & Edma3::kOptStatic)) {
+                if (bcnt > 1) {
+                    p.src += src_bidx;
+                    p.dst += dst_bidx;
+                    p.a_b_cnt = ((bcnt - 1) << 16) | acnt;
+                } else {
+                    p.src += src_cidx;
+                    p.dst += dst_cidx;
+                    p.ccnt--;
+                    p.a_b_cnt = (p.link_bcntrld & 0xFFFF0000) | acnt;
+                }
+            }
+        } else {
+            if (src_bidx == (int)acnt && dst_bidx == (int)acnt) {
+                edmaCopy(p.dst, p.src, acnt * bcnt);  // Contiguous frame: one block
+            } else {
+                for (uint32_t b = 0; b < bcnt; b++) {
+                    edmaCopy(p.dst + b * dst_bidx, p.src + b * src_bidx, acnt);
+                }
+            }
+            last = p.ccnt == 1;
+            if (!(p.opt & Edma3::kOptStatic)) {
+                p.src += src_cidx;
+                p.dst += dst_cidx;
+                p.ccnt--;
+            }
+        }
+        
+        // Finish and follow the link after the set's last transfer
+        if (!last) return;
+        
+        uint32_t opt = p.opt;
+        uint16_t link = p.link_bcntrld & 0xFFFF;
+        if (link != Edma3::kNullLink && link >= Edma3::kPaRAM) {
+            int set = (link - Edma3::kPaRAM) / sizeof(PaRAMSet);
+            if (set < Edma3::kPaRAMSets) p = edma.param[set];
+        }
+        if (opt & Edma3::kOptTcintEn) {
+            edma.ipr |= 1ull << Edma3::tcc(opt);
+            if (edma.ipr & edma.ier) intc.raise(InterruptController::kEdmaInt);
+        }
+        if (opt & Edma3::kOptTcchEn) edmaTrigger((int)Edma3::tcc(opt));
+    }
+
+    uint32_t edmaRead32(uint32_t offset) {
+        if (offset >= Edma3::kPaRAM && offset < Edma3::kPaRAM + sizeof(edma.param)) {
+            uint32_t value;
+            memcpy(&value, (uint8_t*)edma.param.data() + (offset - Edma3::kPaRAM), 4);
+            return value;
+        }
+        if (offset >= Edma3::kDCHMAP && offset < Edma3::kDCHMAP + 4 * Edma3::kChannels) {
+            return (uint32_t)edma.dchmap[(offset - Edma3::kDCHMAP) / 4] << 5;
+        }
+        switch (offset) {
+            case Edma3::kIPR: return (uint32_t)edma.ipr;
+            case Edma3::kIPR + 4: return (uint32_t)(edma.ipr >> 32);
+            case Edma3::kIER: return (uint32_t)edma.ier;
+            case Edma3::kIER + 4: return (uint32_t)(edma.ier >> 32);
+            default: return 0;
+        }
+    }
 
-public:
-    VLIWSimulator() : current_tb_id(0), ILC(0), RILC(0), state(0), A1(0), sploop_start_index(-1) {
-        registers["B1"] = 5;
-        registers["B3"] = 0;
-        registers["A10"] = 100;
-        registers["A2"] = 0;
-        registers["A4"] = 0;
+    void edmaWrite32(uint32_t offset, uint32_t value) {
+        if (offset >= Edma3::kPaRAM && offset < Edma3::kPaRAM + sizeof(edma.param)) {
+            memcpy((uint8_t*)edma.param.data() + (offset - Edma3::kPaRAM), &value, 4);
+            return;
+        }
+        if (offset >= Edma3::kDCHMAP && offset < Edma3::kDCHMAP + 4 * Edma3::kChannels) {
+            edma.dchmap[(offset - Edma3::kDCHMAP) / 4] = (uint16_t)((value >> 5) & 0x1FF);
+            return;
+        }
+        int base_channel = 0;
+        switch (offset) {
+            case Edma3::kESR + 4:
+                base_channel = 32;
+                // fall through
+            case Edma3::kESR:
+                for (int bit = 0; bit < 32; bit++) {
+                    if (value & (1u << bit)) edmaTrigger(base_channel + bit);
+                }
+                break;
+            case Edma3::kICR: edma.ipr &= ~(uint64_t)value; break;
+            case Edma3::kICR + 4: edma.ipr &= ~((uint64_t)value << 32); break;
+            case Edma3::kIER: edma.ier = (edma.ier & ~0xFFFFFFFFull) | value; break;
+            case Edma3::kIER + 4: edma.ier = (edma.ier & 0xFFFFFFFFull) | ((uint64_t)value << 32); break;
+            default: break;
+        }
     }
 
-    Instruction createInstruction(InsnType type, const string& mnemonic, const string& unit,
-                                   int delay, const string& operands, int line, 
-                                   const string& pred = "", bool par = false) {
-        Instruction insn;
-        insn.type = type;
-        insn.mnemonic = mnemonic;
-        insn.unit = unit;
-        insn.delay_slots = delay;
-        insn.operands = operands;
-        insn.line_num = line;
-        insn.predicate = pred;
-        insn.parallel = par;
-        return insn;
+    void chainTB(int from_tb_id, int to_tb_id) {
+        if (from_tb_id != to_tb_id) {
+            translation_blocks[from_tb_id].chain_next = to_tb_id;
+            allocateChainRegisters(from_tb_id);
+        }
     }
 
-    void addEP(int ep_num, int cycles, const Instruction& insn) {
-        ExecutePacket ep;
-        ep.ep_num = ep_num;
-        ep.cycles = cycles;
-        ep.instructions.push_back(insn);
-        guest_code.push_back(ep);
+    // Write a TB's body and exit stubs into the code cache backing. Each guest
+    // instruction gets a kHostBytesPerInsn record (type, delay, line, target)
+    // padded with int3; each stub is a jmp tagged with its TB and exit number.
+    void emitTB(const TranslationBlock& tb) {
+        size_t end = (size_t)tb.stub_offset + tb.exit_stubs * CodeCache::kExitStubBytes;
+        if (!code_cache.mem.base || end > code_cache.mem.size) return;
+        uint8_t* p = code_cache.mem.base + tb.host_offset;
+        for (const auto& ep : tb.packets) {
+            for (int pass = 0; pass < 2; pass++) {  // Stores deferred to the end of the EP, as in the state map
+                for (const auto& insn : ep.instructions) {
+                    if ((insn.type == STORE) != (pass == 1)) continue;
+                    memset(p, 0xCC, CodeCache::kHostBytesPerInsn);
+                    p[0] = (uint8_t)insn.type;
+                    p[1] = (uint8_t)insn.delay_slots;
+                    memcpy(p + 2, &insn.line_num, 4);
+                    memcpy(p + 6, &insn.target_sym, 4);
+                    p += CodeCache::kHostBytesPerInsn;
+                }
+            }
+        }
+        p = code_cache.mem.base + tb.stub_offset;
+        for (int i = 0; i < tb.exit_stubs; i++) {
+            memset(p, 0xCC, CodeCache::kExitStubBytes);
+            p[0] = 0xE9;
+            memcpy(p + 1, &tb.tb_id, 4);
+            memcpy(p + 5, &i, 4);
+            p += CodeCache::kExitStubBytes;
+        }
     }
 
-    void addEP(int ep_num, int cycles, const vector<Instruction>& insns) {
-        ExecutePacket ep;
-        ep.ep_num = ep_num;
-        ep.cycles = cycles;
-        ep.instructions = insns;
-        guest_code.push_back(ep);
+    // Profile-guided relocation: hot TBs in descending execution count, each
+    // followed by its chain of successors, then cold bodies, then all exit stubs.
+    void compactCodeCache() {
+        cout << "\n=== Code Cache Compaction ===" << endl;
+        
+        vector<int> hot;
+        for (const auto& tb : translation_blocks) {
+            if (tb.exec_count >= CodeCache::kHotThreshold) hot.push_back(tb.tb_id);
+        }
+        stable_sort(hot.begin(), hot.end(), [&](int a, int b) {
+            return translation_blocks[a].exec_count > translation_blocks[b].exec_count;
+        });
+        
+        // Old bodies and stubs, copied out before anything moves
+        vector<uint8_t> old_code;
+        bool backed = code_cache.mem.base && (size_t)code_cache.code_end <= code_cache.mem.size;
+        if (backed) old_code.assign(code_cache.mem.base, code_cache.mem.base + code_cache.code_end);
+        vector<pair<int, int>> old_offsets;  // Body, stubs
+        for (const auto& tb : translation_blocks) old_offsets.push_back({tb.host_offset, tb.stub_offset});
+        
+        vector<bool> placed(translation_blocks.size(), false);
+        vector<int> order;
+        for (int id : hot) {
+            for (int next = id; next >= 0 && !placed[next]; next = translation_blocks[next].chain_next) {
+                placed[next] = true;
+                order.push_back(next);
+            }
+        }
+        size_t hot_count = order.size();
+        for (const auto& tb : translation_blocks) {
+            if (!placed[tb.tb_id]) order.push_back(tb.tb_id);
+        }
+        
+        int offset = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            TranslationBlock& tb = translation_blocks[order[i]];
+            tb.host_offset = offset;
+            offset += tb.host_size;
+            if (i + 1 == hot_count) code_cache.hot_end = offset;
+        }
+        if (hot_count == 0) code_cache.hot_end = 0;
+        for (int id : order) {
+            TranslationBlock& tb = translation_blocks[id];
+            tb.stub_offset = offset;
+            offset += tb.exit_stubs * CodeCache::kExitStubBytes;
+        }
+        code_cache.code_end = offset;
+        code_cache.generation++;
+        
+        if (backed) {
+            for (const auto& tb : translation_blocks) {
+                int stub_bytes = tb.exit_stubs * CodeCache::kExitStubBytes;
+                if (old_offsets[tb.tb_id].first >= 0) {
+                    memcpy(code_cache.mem.base + tb.host_offset, old_code.data() + old_offsets[tb.tb_id].first,
+                           tb.host_size);
+                    memcpy(code_cache.mem.base + tb.stub_offset, old_code.data() + old_offsets[tb.tb_id].second,
+                           stub_bytes);
+                }
+            }
+        }
+        
+        for (size_t i = 0; i < order.size(); i++) {
+            const TranslationBlock& tb = translation_blocks[order[i]];
+            cout << "  " << (i < hot_count ? "[hot]  " : "[cold] ") << "TB" << tb.tb_id
+                 << " @" << tb.host_offset << " (" << tb.host_size << " bytes, executed "
+                 << tb.exec_count << "x, stubs @" << tb.stub_offset << ")" << endl;
+        }
+        cout << "Hot region: " << code_cache.hot_end << " bytes (" << hot_count
+             << " TBs), code cache: " << code_cache.code_end << " bytes" << endl;
     }
 
     void parseGuestCode() {
+        guest_code.clear();
+        sploop_start_index = -1;
+        
         for (int i = 1; i <= 5; i++) {
             addEP(i, 1, createInstruction(BRANCH, "B", ".S2", 5, "LOOP", i));
         }
@@ -129,6 +3126,9 @@ public:
         
         addEP(12, 1, createInstruction(ARITHMETIC, "MV", ".L1", 0, "A10, A2", 12));
         addEP(13, 1, createInstruction(ARITHMETIC, "ADD", ".L1", 0, "A4, A2, A4", 13));
+        
+        symbols.intern("LOOP", 0);
+        resolveSymbols();
     }
     
     void parseSoftwarePipelinedLoop() {
@@ -149,6 +3149,29 @@ public:
             createInstruction(STORE, "STW", ".D", 0, "B2, *B0++", 9, "", true)
         };
         addEP(8, 1, parallel_insns);
+        resolveSymbols();
+    }
+    
+    // Figure 4 with a loop-invariant bias added to every word on its way through
+    void parseBiasedCopyLoop() {
+        guest_code.clear();
+        sploop_start_index = -1;
+        
+        addEP(1, 1, createInstruction(ARITHMETIC, "MVK", ".S", 0, "8, A0", 1));
+        addEP(2, 1, createInstruction(ARITHMETIC, "MVC", ".S", 0, "A0, ILC", 2));
+        addEP(3, 3, createInstruction(NOP, "NOP", "", 0, "3", 3));
+        addEP(4, 1, createInstruction(SPLOOP, "SPLOOP", "", 0, "1", 4));
+        sploop_start_index = 4;
+        addEP(5, 1, createInstruction(LOAD, "LDW", ".D1", 4, "*A4++, A5", 5));
+        addEP(6, 4, createInstruction(NOP, "NOP", "", 0, "4", 6));
+        addEP(7, 1, createInstruction(ARITHMETIC, "ADD", ".L1", 0, "A5, A6, A7", 7));
+        
+        vector<Instruction> parallel_insns = {
+            createInstruction(SPKERNEL, "SPKERNEL", "", 0, "6, 0", 8),
+            createInstruction(STORE, "STW", ".D2", 0, "A7, *B4++", 9, "", true)
+        };
+        addEP(8, 1, parallel_insns);
+        resolveSymbols();
     }
     
     void parseNestedSoftwarePipelinedLoop() {
@@ -186,6 +3209,9 @@ public:
         addEP(13, 4, createInstruction(NOP, "NOP", "", 0, "4", 18));
         addEP(14, 1, createInstruction(ARITHMETIC, "OR", ".S2", 0, "B6, 0, B4", 19));
         addEP(15, 1, createInstruction(NOP, "NOP", "", 0, "", 20));
+        
+        symbols.intern("TARGET", 5); // Outer loop re-enters at the [A1] SPLOOP (EP6)
+        resolveSymbols();
     }
 
     TranslationBlock translateWithConstraint(int start_ep, int initial_cycles) {
@@ -221,12 +3247,12 @@ public:
                 if (insn.type == BRANCH) {
                     SavedContext ctx;
                     ctx.remaining_delay = insn.delay_slots;
-                    ctx.target_address = insn.operands;
+                    ctx.target_sym = insn.target_sym;
                     ctx.instruction_line = insn.line_num;
                     saved_contexts.push_back(ctx);
                     
                     cout << "    Saved branch context: delay=" << insn.delay_slots 
-                         << ", target=" << insn.operands << endl;
+                         << ", target=" << symbols.name(insn.target_sym) << endl;
                 }
             }
             
@@ -298,11 +3324,12 @@ public:
             // TRANSLATE ONCE for state 0
             cout << "State 0: Translating first iteration TB (all instructions)" << endl;
             TranslationBlock tb = translateNormalLoop();
-            translation_blocks.push_back(tb);
+            registerTB(tb);
             cout << "Generated TB" << tb.tb_id << " for state 0" << endl;
             
             cout << "\n--- Executing State 0 TB ---" << endl;
             cout << "Iteration 1: Executing TB" << tb.tb_id << " (state 0 - includes all instructions)" << endl;
+            executeTB(tb.tb_id);
             
             ILC--;
             if (ILC > 0) {
@@ -312,15 +3339,13 @@ public:
                 // TRANSLATE ONCE for state 1 (this TB will be executed ILC times)
                 cout << "\nState 1: Translating loop kernel TB (skip prolog, will be executed " << ILC << " times)" << endl;
                 TranslationBlock tb1 = translateKernelLoop();
-                translation_blocks.push_back(tb1);
+                registerTB(tb1);
                 cout << "Generated TB" << tb1.tb_id << " for state 1 (reusable)" << endl;
+                chainTB(tb.tb_id, tb1.tb_id);
                 
                 // Now EXECUTE the state 1 TB multiple times (without re-translating)
                 cout << "\n--- Executing State 1 TB (Loop Kernel) ---" << endl;
-                for (int i = 1; i <= ILC; i++) {
-                    cout << "Iteration " << (i + 1) << ": Executing TB" << tb1.tb_id 
-                         << " (state 1 - kernel only, ILC=" << (ILC - i + 1) << ")" << endl;
-                }
+                runSploopKernel(tb1.tb_id, "Iteration", "Executing", "state 1 - kernel only");
                 ILC = 0; // All iterations completed
                 state = 0;
                 cout << "\nLoop completed, reset to state 0" << endl;
@@ -331,6 +3356,782 @@ public:
         }
     }
 
+    // Run the kernel TB once per remaining ILC iteration (the first iteration
+    // already ran in the state 0 TB). ILC counts down live, so an interrupt taken
+    // at an iteration boundary sees exactly where the loop is.
+    void runSploopKernel(int kernel_tb_id, const char* prefix, const char* verb, const char* desc) {
+        active_kernel_tb = kernel_tb_id;
+        for (int iteration = 2; ILC > 0; iteration++) {
+            cout << prefix << " " << iteration << ": " << verb << " TB" << kernel_tb_id
+                 << " (" << desc << ", ILC=" << ILC << ")" << endl;
+            ILC--;
+            executeTB(kernel_tb_id);
+        }
+        active_kernel_tb = -1;
+    }
+
+    // Interpreter tier: one SPLOOP kernel iteration, EP by EP, tracking the
+    // results in flight the same way the side tables do
+    void interpretKernelIteration(vector<PendingResult>& in_flight) {
+        for (int i = sploop_start_index; i < (int)guest_code.size(); i++) {
+            const ExecutePacket& ep = guest_code[i];
+            global_cycle += ep.cycles;
+            interpreted_eps++;
+            advanceInFlight(in_flight, ep);
+        }
+        serviceEvents();
+        if (intc.anyPending()) {
+            takeInterrupt();
+        }
+    }
+
+    // A kernel TB can be entered at an iteration boundary only if the pipeline
+    // state it was translated for (results carried into its first EP from the
+    // previous iteration) is the one the interpreter has built up
+    static bool osrCompatible(const TranslationBlock& tb, const vector<PendingResult>& in_flight) {
+        if (tb.pending_begin.size() < 2) return false;
+        if (tb.pending_begin[1] - tb.pending_begin[0] != (int)in_flight.size()) return false;
+        for (size_t i = 0; i < in_flight.size(); i++) {
+            const PendingResult& expected = tb.pending_results[tb.pending_begin[0] + i];
+            if (expected.instruction_line != in_flight[i].instruction_line ||
+                expected.remaining_delay != in_flight[i].remaining_delay) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Run a SPLOOP starting in the interpreter. Once the kernel has run
+    // kOsrThreshold iterations the kernel TB is translated and execution
+    // transfers into it at the next iteration boundary with the live ILC.
+    void runSploopTiered() {
+        vector<PendingResult> in_flight;
+        int interpreted = 0;
+        int kernel_tb = -1;
+        while (ILC > 0) {
+            if (kernel_tb < 0 && interpreted >= kOsrThreshold) {
+                int existing = tb_by_label[sym_loop_state_1];
+                if (existing >= 0 && translation_blocks[existing].image == current_image) {
+                    kernel_tb = existing;
+                } else {
+                    TranslationBlock tb = translateKernelLoop();
+                    registerTB(tb);
+                    kernel_tb = tb.tb_id;
+                }
+                if (!osrCompatible(translation_blocks[kernel_tb], in_flight)) {
+                    kernel_tb = -1;  // Pipeline state differs; try the next boundary
+                    interpreted = 0;
+                    continue;
+                }
+                cout << "Kernel hot after " << interpreted << " interpreted iterations: OSR into TB"
+                     << kernel_tb << " with ILC=" << ILC << ", " << in_flight.size()
+                     << " result(s) in flight" << endl;
+                osr_entries++;
+            }
+            ILC--;
+            if (kernel_tb >= 0) {
+                active_kernel_tb = kernel_tb;
+                executeTB(kernel_tb);
+            } else {
+                interpretKernelIteration(in_flight);
+                interpreted++;
+            }
+        }
+        active_kernel_tb = -1;
+    }
+
+    // ---- Predecoded interpreter ----
+
+    // "A10" -> 10, "B2" -> 34, ILC/RILC -> control slots; -1 if not a register
+    static int parseRegister(const string& token) {
+        if (token == "ILC") return PredecodedProgram::kRegILC;
+        if (token == "RILC") return PredecodedProgram::kRegRILC;
+        if (token.size() < 2 || (token[0] != 'A' && token[0] != 'B')) return -1;
+        for (size_t i = 1; i < token.size(); i++) {
+            if (!isdigit((unsigned char)token[i])) return -1;
+        }
+        int n = stoi(token.substr(1));
+        return n < 32 ? n + (token[0] == 'B' ? 32 : 0) : -1;
+    }
+
+    static vector<string> splitOperands(const string& operands) {
+        vector<string> tokens;
+        stringstream ss(operands);
+        string token;
+        while (getline(ss, token, ',')) {
+            size_t b = token.find_first_not_of(' '), e = token.find_last_not_of(' ');
+            if (b != string::npos) tokens.push_back(token.substr(b, e - b + 1));
+        }
+        return tokens;
+    }
+
+    // "*A1++" -> base A1, post-increment 4
+    static bool parseAddress(const string& token, int& base, int32_t& post_inc) {
+        if (token.empty() || token[0] != '*') return false;
+        string reg = token.substr(1);
+        post_inc = 0;
+        if (reg.size() > 2 && reg.compare(reg.size() - 2, 2, "++") == 0) {
+            reg.resize(reg.size() - 2);
+            post_inc = 4;
+        }
+        base = parseRegister(reg);
+        return base >= 0;
+    }
+
+    // Lower one instruction; false if the interpreter does not handle it
+    bool decodeInstruction(const Instruction& insn, int ep_index, DecodedOp& op) {
+        vector<string> ops = splitOperands(insn.operands);
+        op.ep = ep_index;
+        op.delay = (uint8_t)insn.delay_slots;
+        op.pred = PredecodedProgram::kRegOne;
+        if (!insn.predicate.empty()) {
+            bool negate = insn.predicate.size() > 1 && insn.predicate[1] == '!';
+            int reg = parseRegister(insn.predicate.substr(negate ? 2 : 1, insn.predicate.size() - (negate ? 3 : 2)));
+            if (reg < 0) return false;
+            op.pred = (uint8_t)reg;
+            op.pred_zero = negate;
+        }
+        
+        auto reg = [&](size_t i, uint8_t& field) {
+            int r = i < ops.size() ? parseRegister(ops[i]) : -1;
+            field = (uint8_t)max(r, 0);
+            return r >= 0;
+        };
+        switch (insn.type) {
+            case NOP:
+            case SPLOOP:
+            case SPKERNEL:
+                op.opcode = OP_NOP;  // Loop control is carried by the EP end op
+                return true;
+            case SEMIHOST:
+                op.opcode = OP_SEMIHOST;
+                return true;
+            case BRANCH:
+                if (insn.target_sym >= 0 && symbols.epIndex(insn.target_sym) >= 0) {
+                    op.opcode = OP_BRANCH;
+                    op.target = symbols.epIndex(insn.target_sym);
+                    return true;
+                }
+                op.opcode = OP_BRANCH_EXIT;  // Register target: leave the interpreter
+                return reg(0, op.src1);
+            case LOAD: {
+                int base;
+                if (ops.size() != 2 || !parseAddress(ops[0], base, op.imm) || !reg(1, op.dst)) return false;
+                op.opcode = OP_LDW;
+                op.src1 = (uint8_t)base;
+                return true;
+            }
+            case STORE: {
+                int base;
+                if (ops.size() != 2 || !reg(0, op.src2) || !parseAddress(ops[1], base, op.imm)) return false;
+                op.opcode = OP_STW;
+                op.src1 = (uint8_t)base;
+                return true;
+            }
+            case ARITHMETIC: {
+                if (insn.mnemonic == "MVK") {
+                    op.opcode = OP_MVK;
+                    op.imm = (int32_t)strtol(ops.empty() ? "" : ops[0].c_str(), nullptr, 0);
+                    return ops.size() == 2 && reg(1, op.dst);
+                }
+                if (insn.mnemonic == "MV" || insn.mnemonic == "MVC") {
+                    op.opcode = OP_MV;
+                    return ops.size() == 2 && reg(0, op.src1) && reg(1, op.dst);
+                }
+                if (insn.mnemonic == "ADD" || insn.mnemonic == "SUB") {
+                    if (ops.size() != 3 || !reg(0, op.src1) || !reg(2, op.dst)) return false;
+                    bool add = insn.mnemonic == "ADD";
+                    if (reg(1, op.src2)) {
+                        op.opcode = add ? OP_ADD : OP_SUB;
+                    } else {
+                        op.opcode = add ? OP_ADDK : OP_SUBK;
+                        op.imm = (int32_t)strtol(ops[1].c_str(), nullptr, 0);
+                    }
+                    return true;
+                }
+                return false;
+            }
+            default:
+                return false;
+        }
+    }
+
+    static void opRegisters(const DecodedOp& op, vector<int>& reads, vector<int>& writes) {
+        reads = {op.pred};
+        writes.clear();
+        switch (op.opcode) {
+            case OP_MV: reads.push_back(op.src1); writes.push_back(op.dst); break;
+            case OP_MVK: writes.push_back(op.dst); break;
+            case OP_ADD: case OP_SUB: reads.push_back(op.src2); // fallthrough
+            case OP_ADDK: case OP_SUBK: reads.push_back(op.src1); writes.push_back(op.dst); break;
+            case OP_LDW: reads.push_back(op.src1); writes.push_back(op.src1);
+                         if (op.delay == 0) writes.push_back(op.dst);
+                         break;
+            case OP_STW: reads.push_back(op.src1); reads.push_back(op.src2); writes.push_back(op.src1); break;
+            case OP_BRANCH_EXIT: reads.push_back(op.src1); break;
+            case OP_SEMIHOST: reads.insert(reads.end(), {4, 36, 6, 38}); writes.push_back(4); break;
+            default: break;
+        }
+    }
+
+    // Ops in an EP read their operands in parallel. Issue any op that reads a
+    // register before the op that writes it ([B1] SUB B1 || [B1] B LOOP).
+    // False if the writes form a cycle (MV A1, A2 || MV A2, A1), which no
+    // order can serialize.
+    static bool orderForParallelReads(vector<DecodedOp>& ep_ops) {
+        vector<DecodedOp> ordered;
+        vector<int> reads, writes, other_reads, other_writes;
+        while (!ep_ops.empty()) {
+            size_t pick = ep_ops.size();
+            for (size_t i = 0; i < ep_ops.size(); i++) {
+                opRegisters(ep_ops[i], reads, writes);
+                bool clobbers = false;
+                for (size_t j = 0; j < ep_ops.size() && !clobbers; j++) {
+                    if (j == i) continue;
+                    opRegisters(ep_ops[j], other_reads, other_writes);
+                    for (int w : writes) {
+                        if (find(other_reads.begin(), other_reads.end(), w) != other_reads.end()) clobbers = true;
+                    }
+                }
+                if (!clobbers) { pick = i; break; }
+            }
+            if (pick == ep_ops.size()) return false;
+            ordered.push_back(ep_ops[pick]);
+            ep_ops.erase(ep_ops.begin() + pick);
+        }
+        ep_ops = ordered;
+        return true;
+    }
+
+    // Lower the current image once; EPs the interpreter cannot run become a
+    // bail-out op so the caller falls back to translation
+    void predecodeImage() {
+        if (predecoded.image == current_image) return;
+        predecoded = PredecodedProgram();
+        predecoded.image = current_image;
+        vector<vector<DecodedOp>> eps;
+        int body_start = 0, loop_ep = -1;
+        for (int i = 0; i < (int)guest_code.size(); i++) {
+            const ExecutePacket& ep = guest_code[i];
+            vector<DecodedOp> ep_ops;
+            bool supported = true;
+            bool loop_end = false, reload = false;
+            for (const auto& insn : ep.instructions) {
+                DecodedOp op;
+                supported = supported && decodeInstruction(insn, i, op);
+                if (op.opcode != OP_NOP) ep_ops.push_back(op);  // NOPs are counted by the EP end op
+                if (insn.type == SPLOOP) body_start = i + 1;
+                if (insn.type == SPKERNEL) {
+                    loop_end = true;
+                    reload = insn.mnemonic == "SPKERNELR";
+                }
+            }
+            supported = supported && orderForParallelReads(ep_ops);
+            if (!supported) {
+                DecodedOp bail;
+                bail.opcode = OP_BAIL;
+                bail.ep = i;
+                eps.push_back({bail});
+                continue;
+            }
+            DecodedOp end;
+            end.opcode = loop_end ? OP_EP_END_LOOP : OP_EP_END;
+            end.ep = i;
+            end.imm = ep.cycles;
+            end.count = (uint8_t)ep.instructions.size();
+            end.target = body_start;
+            end.src1 = reload;
+            ep_ops.push_back(end);
+            eps.push_back(ep_ops);
+            if (loop_end) loop_ep = i;
+        }
+        if (rename_kernel_moves && loop_ep >= body_start) {
+            renameKernelMoves(eps, body_start, loop_ep);
+        }
+        if (vectorize_sploop && loop_ep >= body_start && vectorizableBody(eps, body_start, loop_ep)) {
+            DecodedOp entry;
+            entry.opcode = OP_VECTOR_LOOP;
+            entry.ep = body_start;
+            eps[body_start].insert(eps[body_start].begin(), entry);
+        }
+        
+        for (const auto& ep_ops : eps) {
+            predecoded.ep_start.push_back((int)predecoded.ops.size());
+            for (const auto& op : ep_ops) {
+                vector<int> reads, writes;
+                opRegisters(op, reads, writes);
+                if (op.opcode == OP_LDW) writes.push_back(op.dst);
+                for (int w : writes) predecoded.written[w] = true;
+                predecoded.ops.push_back(op);
+            }
+        }
+        for (const auto& move : predecoded.renamed_moves) predecoded.written[move.first] = true;
+        predecoded.ep_start.push_back((int)predecoded.ops.size());
+        DecodedOp exit_op;
+        exit_op.opcode = OP_EXIT;
+        exit_op.ep = (int)guest_code.size();
+        predecoded.ops.push_back(exit_op);
+    }
+
+    // A SPLOOP body can run 8 iterations at a time if its iterations are
+    // independent apart from post-incremented pointers: every register it reads
+    // is loop-invariant or defined earlier in the same iteration (loads must
+    // have landed), each pointer steps by one word for one LDW/STW and feeds
+    // nothing else, and there is no control flow or ILC reload.
+    bool vectorizableBody(const vector<vector<DecodedOp>>& eps, int body_start, int loop_ep) {
+        vector<int> def_op(PredecodedProgram::kRegCount, -1);   // Body position of the single def
+        vector<int> visible_at(PredecodedProgram::kRegCount, 0);  // Cycle its value can be read
+        vector<int> mem_uses(PredecodedProgram::kRegCount, 0);
+        vector<const DecodedOp*> body;
+        vector<int> issue_cycle;
+        int cycle = 0, insns = 0;
+        for (int i = body_start; i <= loop_ep; i++) {
+            for (const auto& op : eps[i]) {
+                if (op.opcode == OP_EP_END || op.opcode == OP_EP_END_LOOP) {
+                    cycle += op.imm;
+                    insns += op.count;
+                    if (op.opcode == OP_EP_END_LOOP && op.src1) return false;  // SPKERNELR
+                    continue;
+                }
+                body.push_back(&op);
+                issue_cycle.push_back(cycle);
+            }
+        }
+        
+        vector<int> reads, writes;
+        for (size_t k = 0; k < body.size(); k++) {
+            const DecodedOp& op = *body[k];
+            switch (op.opcode) {
+                case OP_LDW: case OP_STW:
+                    if (op.imm != 4) return false;
+                    mem_uses[op.src1]++;
+                    break;
+                case OP_MV: case OP_MVK: case OP_ADD: case OP_ADDK: case OP_SUB: case OP_SUBK:
+                    break;
+                default:
+                    return false;
+            }
+            if (op.pred != PredecodedProgram::kRegOne) return false;
+            opRegisters(op, reads, writes);
+            if (op.opcode == OP_LDW) writes.push_back(op.dst);
+            for (int w : writes) {
+                if (w >= 64) return false;  // ILC/RILC
+                bool is_pointer = (op.opcode == OP_LDW || op.opcode == OP_STW) && w == op.src1;
+                if (is_pointer) continue;
+                if (def_op[w] >= 0) return false;
+                def_op[w] = (int)k;
+                visible_at[w] = op.opcode == OP_LDW ? issue_cycle[k] + 1 + op.delay : issue_cycle[k];
+                if (visible_at[w] > cycle) return false;  // Lands in a later iteration
+            }
+        }
+        
+        vector<bool> invariant(PredecodedProgram::kRegCount, false);
+        for (size_t k = 0; k < body.size(); k++) {
+            const DecodedOp& op = *body[k];
+            opRegisters(op, reads, writes);
+            for (int r : reads) {
+                if (r == PredecodedProgram::kRegOne) continue;
+                bool is_pointer = (op.opcode == OP_LDW || op.opcode == OP_STW) && r == op.src1;
+                if (mem_uses[r] > (is_pointer ? 1 : 0)) return false;  // Pointer shared or used as a value
+                if (is_pointer) continue;
+                if (def_op[r] < 0) {
+                    invariant[r] = true;
+                } else if (def_op[r] >= (int)k || visible_at[r] > issue_cycle[k]) {
+                    return false;  // Value from the previous iteration
+                }
+            }
+        }
+        
+        for (const DecodedOp* op : body) {
+            predecoded.vector_ops.push_back(*op);
+            if (op->opcode == OP_LDW || op->opcode == OP_STW) {
+                predecoded.vector_guard.add(op->src1, op->imm, op->opcode == OP_STW);
+            }
+        }
+        for (int r = 0; r < PredecodedProgram::kRegCount; r++) {
+            if (invariant[r]) predecoded.vector_invariants.push_back(r);
+        }
+        predecoded.vector_body_cycles = cycle;
+        predecoded.vector_body_insns = insns;
+        predecoded.loop_exit_ep = loop_ep + 1;
+        return true;
+    }
+
+    // Run trips * 8 iterations of the vectorized body. False (nothing done) if
+    // the range guard fails for the rest of the loop or a pointer range is not
+    // plain RAM; the scalar body then runs as written.
+    bool runVectorTrips(uint32_t* regs, uint64_t trips) {
+        const vector<DecodedOp>& vops = predecoded.vector_ops;
+        const size_t bytes = trips * kVectorLanes * 4;
+        if (!watchpoints.empty()) return false;
+        if (!predecoded.vector_guard.passes(regs, regs[PredecodedProgram::kRegILC])) return false;
+        vector<uint8_t*> host(vops.size(), nullptr);
+        for (size_t k = 0; k < vops.size(); k++) {
+            if (vops[k].opcode != OP_LDW && vops[k].opcode != OP_STW) continue;
+            host[k] = hostAddress(regs[vops[k].src1], bytes, vops[k].opcode == OP_STW);
+            if (!host[k]) return false;
+        }
+        
+        VectorLanes v[PredecodedProgram::kRegCount];
+        for (int r : predecoded.vector_invariants) v[r] = VectorLanes{} + regs[r];
+        HostThreadPool* pool = trips >= kParallelMinTrips ? hostPool() : nullptr;
+        if (!pool) {
+            runVectorRange(vops, host, 0, trips, v);
+        } else {
+            // Iterations are independent, so contiguous trip ranges can run on
+            // any thread; the range holding the last trip leaves the registers
+            int tasks = pool->size() * 4;
+            vector<VectorLanes> last(v, v + PredecodedProgram::kRegCount);
+            pool->parallelFor(tasks, [&](int task) {
+                uint64_t first = trips * task / tasks, end = trips * (task + 1) / tasks;
+                VectorLanes lanes[PredecodedProgram::kRegCount];
+                memcpy(lanes, v, sizeof(lanes));
+                runVectorRange(vops, host, first, end, lanes);
+                if (task == tasks - 1) memcpy(last.data(), lanes, sizeof(lanes));
+            });
+            memcpy(v, last.data(), sizeof(v));
+            parallel_trips += trips;
+        }
+        
+        // Registers end as the last lane left them; pointers skip every lane
+        for (const auto& op : vops) {
+            if (op.opcode == OP_LDW || op.opcode == OP_STW) {
+                regs[op.src1] += (uint32_t)bytes;
+                if (op.opcode == OP_STW) continue;
+            }
+            if (op.opcode != OP_STW) regs[op.dst] = v[op.dst][kVectorLanes - 1];
+        }
+        return true;
+    }
+
+    static void runVectorRange(const vector<DecodedOp>& vops, const vector<uint8_t*>& host, uint64_t first,
+                               uint64_t end, VectorLanes* v) {
+        for (uint64_t t = first; t < end; t++) {
+            size_t offset = t * kVectorLanes * 4;
+            for (size_t k = 0; k < vops.size(); k++) {
+                const DecodedOp& op = vops[k];
+                switch (op.opcode) {
+                    case OP_LDW: memcpy(&v[op.dst], host[k] + offset, sizeof(VectorLanes)); break;
+                    case OP_STW: memcpy(host[k] + offset, &v[op.src2], sizeof(VectorLanes)); break;
+                    case OP_MV: v[op.dst] = v[op.src1]; break;
+                    case OP_MVK: v[op.dst] = VectorLanes{} + (uint32_t)op.imm; break;
+                    case OP_ADD: v[op.dst] = v[op.src1] + v[op.src2]; break;
+                    case OP_ADDK: v[op.dst] = v[op.src1] + (uint32_t)op.imm; break;
+                    case OP_SUB: v[op.dst] = v[op.src1] - v[op.src2]; break;
+                    case OP_SUBK: v[op.dst] = v[op.src1] - (uint32_t)op.imm; break;
+                }
+            }
+        }
+    }
+
+    // Created on first use so cores that never run a long loop start no threads
+    HostThreadPool* hostPool() {
+        int threads = host_threads > 0 ? host_threads : (int)thread::hardware_concurrency();
+        if (threads <= 1) return nullptr;
+        if (!host_pool || host_pool->size() != threads) host_pool.reset(new HostThreadPool(threads));
+        return host_pool.get();
+    }
+
+    // Register renaming across the SPLOOP body. An unconditional MV whose
+    // destination is only read later in the same iteration is removed, and
+    // those reads take the source register instead (LDW A2 -> MV A2, B2 -> STW B2
+    // becomes LDW A2 -> STW A2). The destination is written once on loop exit,
+    // or when the interpreter stops inside the body, so results do not change.
+    // Only one move per loop is renamed; exits inside the body before the last
+    // EP are deferred to the loop end, where the move's value is known.
+    void renameKernelMoves(vector<vector<DecodedOp>>& eps, int body_start, int loop_ep) {
+        vector<DecodedOp*> body;
+        for (int i = body_start; i <= loop_ep; i++) {
+            for (auto& op : eps[i]) body.push_back(&op);
+        }
+        vector<int> reads, writes;
+        auto writesReg = [&](const DecodedOp& op, int reg) {
+            opRegisters(op, reads, writes);
+            if (op.opcode == OP_LDW) writes.push_back(op.dst);
+            return find(writes.begin(), writes.end(), reg) != writes.end();
+        };
+        auto readsReg = [&](const DecodedOp& op, int reg) {
+            opRegisters(op, reads, writes);
+            return find(reads.begin(), reads.end(), reg) != reads.end();
+        };
+        
+        for (size_t p = 0; p < body.size(); p++) {
+            const DecodedOp mv = *body[p];
+            if (mv.opcode != OP_MV || mv.pred != PredecodedProgram::kRegOne || mv.dst >= 64 || mv.src1 >= 64) continue;
+            int dst = mv.dst, src = mv.src1;
+            bool ok = true;
+            bool src_written = false;  // Before the current position
+            for (size_t i = 0; i < body.size() && ok; i++) {
+                const DecodedOp& op = *body[i];
+                if (i == p) continue;
+                if (op.opcode == OP_BRANCH || op.opcode == OP_BRANCH_EXIT || op.opcode == OP_BAIL) ok = false;
+                if (i < p && readsReg(op, dst)) ok = false;  // Needs last iteration's value
+                if (writesReg(op, dst)) ok = false;
+                if (i > p && writesReg(op, src)) ok = false;
+                // A fault here must be able to rebuild dst from src
+                if (i < p && src_written && (op.opcode == OP_LDW || op.opcode == OP_STW)) ok = false;
+                if (i < p && writesReg(op, src)) src_written = true;
+            }
+            if (!ok) continue;
+            
+            for (size_t i = p + 1; i < body.size(); i++) {
+                DecodedOp& op = *body[i];
+                bool value_read = op.opcode == OP_MV || op.opcode == OP_ADD || op.opcode == OP_ADDK ||
+                                  op.opcode == OP_SUB || op.opcode == OP_SUBK || op.opcode == OP_STW ||
+                                  op.opcode == OP_BRANCH_EXIT;
+                if (op.pred == dst) op.pred = (uint8_t)src;
+                if (value_read && op.opcode != OP_STW && op.src1 == dst) op.src1 = (uint8_t)src;
+                if ((op.opcode == OP_ADD || op.opcode == OP_SUB || op.opcode == OP_STW) && op.src2 == dst) {
+                    op.src2 = (uint8_t)src;
+                }
+                op.flags |= DecodedOp::kAfterRename;
+            }
+            for (size_t i = 0; i < body.size(); i++) {
+                body[i]->flags |= DecodedOp::kInRenamedBody;
+                if (body[i]->opcode == OP_EP_END) body[i]->flags |= DecodedOp::kNoExit;
+            }
+            body[p]->opcode = OP_NOP;  // Dropped below
+            predecoded.renamed_moves.push_back({(uint8_t)dst, (uint8_t)src});
+            break;
+        }
+        for (int i = body_start; i <= loop_ep; i++) {
+            eps[i].erase(remove_if(eps[i].begin(), eps[i].end(),
+                                   [](const DecodedOp& op) { return op.opcode == OP_NOP; }),
+                         eps[i].end());
+        }
+    }
+
+    // Run predecoded ops from start_ep until max_cycles guest cycles have
+    // elapsed (checked at EP ends), a register branch leaves the code, or an EP
+    // needs the translator. Dispatch is direct-threaded through computed gotos.
+    // A budget or stop exit hands back the branches and loads still in their
+    // delay slots; pass them in as pending to resume where it left off.
+    InterpResult interpret(int start_ep, uint64_t max_cycles, const vector<InterpEffect>& pending = {}) {
+        static const void* const kHandlers[OP_COUNT] = {
+            &&op_nop, &&op_mvk, &&op_mv, &&op_add, &&op_addk, &&op_sub, &&op_subk, &&op_ldw, &&op_stw,
+            &&op_branch, &&op_branch_exit, &&op_ep_end, &&op_ep_end_loop, &&op_bail, &&op_exit,
+            &&op_vector_loop, &&op_semihost
+        };
+        predecodeImage();
+        PredecodedProgram& prog = predecoded;
+        if (!prog.threaded) {
+            for (auto& op : prog.ops) op.handler = kHandlers[op.opcode];
+            prog.threaded = true;
+        }
+        
+        uint32_t* regs = interp_regs;
+        for (const auto& entry : registers) {
+            int r = parseRegister(entry.first);
+            if (r >= 0) regs[r] = (uint32_t)entry.second;
+        }
+        regs[PredecodedProgram::kRegILC] = (uint32_t)ILC;
+        regs[PredecodedProgram::kRegRILC] = (uint32_t)RILC;
+        regs[PredecodedProgram::kRegOne] = 1;
+        
+        InterpResult result;
+        InterpEffect effects[kMaxDelayedEffects];
+        int num_effects = 0;
+        for (const auto& effect : pending) {
+            if (num_effects < kMaxDelayedEffects) effects[num_effects++] = effect;
+        }
+        uint64_t cycle = 0, insns = 0;
+        int redirect = -1;
+        bool body_repeated = false;  // A renamed loop body has looped back in this call
+        bool vector_declined = false;  // Guard failed; stay scalar until the loop exits
+        const DecodedOp* const ops = prog.ops.data();
+        const int* const ep_start = prog.ep_start.data();
+        const DecodedOp* ip = ops + ep_start[min(max(start_ep, 0), (int)guest_code.size())];
+        
+#define INTERP_NEXT() goto *(++ip)->handler
+#define INTERP_PREDICATED_OFF() ((regs[ip->pred] == 0) != (bool)ip->pred_zero)
+#define INTERP_DELAY(target_ep, r, v) \
+        do { \
+            if (num_effects == kMaxDelayedEffects) { result.status = INTERP_BAIL; result.ep_index = ip->ep; goto out; } \
+            effects[num_effects++] = InterpEffect{cycle + 1 + ip->delay, (target_ep), (r), (v)}; \
+        } while (0)
+        
+        goto *ip->handler;
+        
+    op_nop:
+        INTERP_NEXT();
+    op_mvk:
+        if (!INTERP_PREDICATED_OFF()) regs[ip->dst] = (uint32_t)ip->imm;
+        INTERP_NEXT();
+    op_mv:
+        if (!INTERP_PREDICATED_OFF()) regs[ip->dst] = regs[ip->src1];
+        INTERP_NEXT();
+    op_add:
+        if (!INTERP_PREDICATED_OFF()) regs[ip->dst] = regs[ip->src1] + regs[ip->src2];
+        INTERP_NEXT();
+    op_addk:
+        if (!INTERP_PREDICATED_OFF()) regs[ip->dst] = regs[ip->src1] + (uint32_t)ip->imm;
+        INTERP_NEXT();
+    op_sub:
+        if (!INTERP_PREDICATED_OFF()) regs[ip->dst] = regs[ip->src1] - regs[ip->src2];
+        INTERP_NEXT();
+    op_subk:
+        if (!INTERP_PREDICATED_OFF()) regs[ip->dst] = regs[ip->src1] - (uint32_t)ip->imm;
+        INTERP_NEXT();
+    op_ldw: {
+        if (INTERP_PREDICATED_OFF()) INTERP_NEXT();
+        uint32_t addr = regs[ip->src1], value;
+        uint8_t* host = hostAddress(addr, 4);
+        if (host) {
+            memcpy(&value, host, 4);
+        } else if (!guestLoad32(addr, value)) {
+            result.status = INTERP_FAULT;
+            result.fault_addr = addr;
+            result.ep_index = ip->ep;
+            goto out;
+        }
+        regs[ip->src1] += ip->imm;
+        if (ip->delay) {
+            INTERP_DELAY(-1, ip->dst, value);
+        } else {
+            regs[ip->dst] = value;
+        }
+        INTERP_NEXT();
+    }
+    op_stw: {
+        if (INTERP_PREDICATED_OFF()) INTERP_NEXT();
+        uint32_t addr = regs[ip->src1];
+        uint8_t* host = hostAddress(addr, 4, true);
+        if (host) {
+            memcpy(host, &regs[ip->src2], 4);
+        } else if (!guestStore32(addr, regs[ip->src2])) {
+            result.status = INTERP_FAULT;
+            result.fault_addr = addr;
+            result.ep_index = ip->ep;
+            goto out;
+        }
+        regs[ip->src1] += ip->imm;
+        INTERP_NEXT();
+    }
+    op_branch:
+        if (!INTERP_PREDICATED_OFF()) INTERP_DELAY(ip->target, 0, 0);
+        INTERP_NEXT();
+    op_branch_exit:
+        if (!INTERP_PREDICATED_OFF()) INTERP_DELAY(-2, 0, 0);
+        INTERP_NEXT();
+    op_ep_end_loop:
+    op_ep_end: {
+        cycle += ip->imm;
+        insns += ip->count;
+        if (num_effects) {
+            // Retire results and branches whose delay slots have elapsed
+            for (int i = 0; i < num_effects; ) {
+                if (effects[i].due > cycle) { i++; continue; }
+                if (effects[i].target == -1) {
+                    regs[effects[i].reg] = effects[i].value;
+                } else {
+                    redirect = effects[i].target;
+                }
+                effects[i] = effects[--num_effects];
+            }
+        }
+        int next_ep = ip->ep + 1;
+        if (redirect != -1) {
+            next_ep = redirect;
+            redirect = -1;
+        } else if (ip->opcode == OP_EP_END_LOOP) {
+            // SPKERNEL: the body repeats until ILC runs out; SPKERNELR reloads it
+            if (--regs[PredecodedProgram::kRegILC] > 0) {
+                next_ep = ip->target;
+                body_repeated = true;
+            } else {
+                if (ip->src1) regs[PredecodedProgram::kRegILC] = regs[PredecodedProgram::kRegRILC];
+                for (const auto& move : prog.renamed_moves) regs[move.first] = regs[move.second];
+                body_repeated = false;
+                vector_declined = false;
+            }
+        }
+        if (next_ep == -2) {
+            result.status = INTERP_EXIT;
+            result.ep_index = ip->ep + 1;
+            goto out;
+        }
+        if ((cycle >= max_cycles || stop_pending) && !(ip->flags & DecodedOp::kNoExit)) {
+            result.status = stop_pending ? INTERP_STOP : INTERP_BUDGET;
+            result.ep_index = next_ep;
+            goto out;
+        }
+        ip = ops + ep_start[next_ep];
+        goto *ip->handler;
+    }
+    op_vector_loop: {
+        // Whole groups of 8 iterations that fit the cycle budget; the scalar
+        // body that follows runs the remainder
+        uint64_t per_trip = (uint64_t)kVectorLanes * prog.vector_body_cycles;
+        uint64_t trips = regs[PredecodedProgram::kRegILC] / kVectorLanes;
+        if (max_cycles != UINT64_MAX) trips = min(trips, cycle < max_cycles ? (max_cycles - cycle) / per_trip : 0);
+        if (trips == 0 || num_effects || vector_declined) INTERP_NEXT();
+        if (!runVectorTrips(regs, trips)) {
+            vector_declined = true;
+            INTERP_NEXT();
+        }
+        cycle += trips * per_trip;
+        insns += trips * kVectorLanes * prog.vector_body_insns;
+        vector_iterations += trips * kVectorLanes;
+        regs[PredecodedProgram::kRegILC] -= (uint32_t)(trips * kVectorLanes);
+        body_repeated = true;
+        if (regs[PredecodedProgram::kRegILC] > 0) INTERP_NEXT();
+        for (const auto& move : prog.renamed_moves) regs[move.first] = regs[move.second];
+        body_repeated = false;
+        if (cycle >= max_cycles || stop_pending) {
+            result.status = stop_pending ? INTERP_STOP : INTERP_BUDGET;
+            result.ep_index = prog.loop_exit_ep;
+            goto out;
+        }
+        ip = ops + ep_start[prog.loop_exit_ep];
+        goto *ip->handler;
+    }
+    op_semihost:
+        // SWE: operation in A4, arguments in B4, A6, B6, result back in A4
+        if (!INTERP_PREDICATED_OFF()) regs[4] = (uint32_t)semihostCall(regs[4], regs[36], regs[6], regs[38]);
+        INTERP_NEXT();
+    op_bail:
+        result.status = INTERP_BAIL;
+        result.ep_index = ip->ep;
+        goto out;
+    op_exit:
+        result.status = INTERP_EXIT;
+        result.ep_index = ip->ep;
+        
+#undef INTERP_NEXT
+#undef INTERP_PREDICATED_OFF
+#undef INTERP_DELAY
+    out:
+        if (result.status == INTERP_BUDGET || result.status == INTERP_STOP) {
+            // The next call picks these up at the same point in their delay slots
+            for (int i = 0; i < num_effects; i++) {
+                InterpEffect effect = effects[i];
+                effect.due -= cycle;
+                result.pending.push_back(effect);
+            }
+        } else {
+            // Results still in flight land before control returns to the caller
+            for (int i = 0; i < num_effects; i++) {
+                if (effects[i].target == -1) regs[effects[i].reg] = effects[i].value;
+            }
+        }
+        // Inside a renamed body the removed move's destination lives in its
+        // source once the move's position has passed in some iteration
+        if ((ip->flags & DecodedOp::kInRenamedBody) && (body_repeated || (ip->flags & DecodedOp::kAfterRename))) {
+            for (const auto& move : prog.renamed_moves) regs[move.first] = regs[move.second];
+        }
+        for (int r = 0; r < 64; r++) {
+            if (prog.written[r]) registers[debugRegisterName(r)] = (int)regs[r];
+        }
+        ILC = (int)regs[PredecodedProgram::kRegILC];
+        RILC = (int)regs[PredecodedProgram::kRegRILC];
+        global_cycle += cycle;
+        serviceEvents();
+        
+        result.insns = insns;
+        result.cycles = cycle;
+        return result;
+    }
+
     void translateNestedLoop() {
         cout << "\n=== Nested Software-Pipelined Loop Translation ===" << endl;
         cout << "State: " << state << ", ILC: " << ILC << ", RILC: " << RILC << ", A1: " << A1 << endl;
@@ -339,11 +4140,12 @@ public:
             // TRANSLATE ONCE: First iteration of outer loop
             cout << "State 0: Translating prolog TB (first iteration of outer loop)" << endl;
             TranslationBlock tb0 = translateNestedProlog();
-            translation_blocks.push_back(tb0);
+            registerTB(tb0);
             cout << "Generated TB" << tb0.tb_id << " for state 0 (prolog)" << endl;
             
             cout << "\n--- Executing State 0 TB (Prolog) ---" << endl;
             cout << "Inner iteration 1: Executing TB" << tb0.tb_id << " (state 0 - prolog)" << endl;
+            executeTB(tb0.tb_id);
             
             ILC--;
             if (ILC > 0) {
@@ -353,15 +4155,13 @@ public:
                 // TRANSLATE ONCE for state 1 (inner loop body - will be executed ILC times)
                 cout << "\nState 1: Translating inner loop body TB (will be executed " << ILC << " times)" << endl;
                 TranslationBlock tb1 = translateNestedInner();
-                translation_blocks.push_back(tb1);
+                registerTB(tb1);
                 cout << "Generated TB" << tb1.tb_id << " for state 1 (reusable inner loop body)" << endl;
+                chainTB(tb0.tb_id, tb1.tb_id);
                 
                 // EXECUTE the inner loop body TB multiple times
                 cout << "\n--- Executing State 1 TB (Inner Loop Body) ---" << endl;
-                for (int i = 1; i <= ILC; i++) {
-                    cout << "Inner iteration " << (i + 1) << ": Executing TB" << tb1.tb_id 
-                         << " (state 1 - inner body, ILC=" << (ILC - i + 1) << ")" << endl;
-                }
+                runSploopKernel(tb1.tb_id, "Inner iteration", "Executing", "state 1 - inner body");
                 
                 ILC = 0; // Inner loop completed
                 ILC = RILC;  // Reload for next outer iteration
@@ -388,19 +4188,13 @@ public:
             }
         } else if (state == 2) {
             // Check if we already have a state 2 TB (reuse it)
-            int state2_tb_id = -1;
-            for (const auto& tb : translation_blocks) {
-                if (tb.start_label == "NESTED_STATE_2") {
-                    state2_tb_id = tb.tb_id;
-                    break;
-                }
-            }
+            int state2_tb_id = tb_by_label[sym_nested_state_2];
             
             if (state2_tb_id == -1) {
                 // TRANSLATE ONCE: Overlap section (first time in state 2)
                 cout << "State 2: Translating overlap TB (outer epilog + next inner prolog with SPMASK)" << endl;
                 TranslationBlock tb2 = translateNestedOverlap();
-                translation_blocks.push_back(tb2);
+                registerTB(tb2);
                 state2_tb_id = tb2.tb_id;
                 cout << "Generated TB" << state2_tb_id << " for state 2 (overlap section)" << endl;
             } else {
@@ -409,38 +4203,26 @@ public:
             
             cout << "\n--- Executing State 2 TB (Overlap) ---" << endl;
             cout << "Overlap: Executing TB" << state2_tb_id << " (state 2 - synchronizing loops)" << endl;
+            executeTB(state2_tb_id);
             
             // After overlap, the inner loop restarts
             cout << "\n--- Executing State 0 TB (Prolog of new inner loop) ---" << endl;
             // Find and reuse state 0 TB
-            int state0_tb_id = -1;
-            for (const auto& tb : translation_blocks) {
-                if (tb.start_label == "NESTED_STATE_0") {
-                    state0_tb_id = tb.tb_id;
-                    break;
-                }
-            }
+            int state0_tb_id = tb_by_label[sym_nested_state_0];
             if (state0_tb_id != -1) {
                 cout << "Inner iteration 1: Re-executing TB" << state0_tb_id << " (state 0 - prolog)" << endl;
+                chainTB(state2_tb_id, state0_tb_id);
+                executeTB(state0_tb_id);
             }
             
             ILC--;
             if (ILC > 0) {
                 // Re-use the state 1 TB from before
                 cout << "\n--- Re-using State 1 TB (Inner Loop Body) ---" << endl;
-                int state1_tb_id = -1;
-                for (const auto& tb : translation_blocks) {
-                    if (tb.start_label == "NESTED_STATE_1") {
-                        state1_tb_id = tb.tb_id;
-                        break;
-                    }
-                }
+                int state1_tb_id = tb_by_label[sym_nested_state_1];
                 
                 if (state1_tb_id != -1) {
-                    for (int i = 1; i <= ILC; i++) {
-                        cout << "Inner iteration " << (i + 1) << ": Re-executing TB" << state1_tb_id 
-                             << " (state 1 - inner body, ILC=" << (ILC - i + 1) << ")" << endl;
-                    }
+                    runSploopKernel(state1_tb_id, "Inner iteration", "Re-executing", "state 1 - inner body");
                 }
                 
                 ILC = 0;
@@ -470,7 +4252,7 @@ public:
     TranslationBlock translateNormalLoop() {
         TranslationBlock tb;
         tb.tb_id = current_tb_id++;
-        tb.start_label = "LOOP_STATE_0";
+        tb.label_sym = sym_loop_state_0;
         
         cout << "  Translating EPs into TB" << tb.tb_id << ":" << endl;
         for (size_t i = 0; i < guest_code.size(); i++) {
@@ -493,7 +4275,8 @@ public:
     TranslationBlock translateKernelLoop() {
         TranslationBlock tb;
         tb.tb_id = current_tb_id++;
-        tb.start_label = "LOOP_STATE_1";
+        tb.label_sym = sym_loop_state_1;
+        tb.kernel_loop = true;
         
         cout << "  Translating kernel EPs into TB" << tb.tb_id << " (skip prolog):" << endl;
         
@@ -525,7 +4308,7 @@ public:
     TranslationBlock translateNestedProlog() {
         TranslationBlock tb;
         tb.tb_id = current_tb_id++;
-        tb.start_label = "NESTED_STATE_0";
+        tb.label_sym = sym_nested_state_0;
         
         cout << "  Translating prolog instructions into TB" << tb.tb_id << ":" << endl;
         for (int i = 0; i < sploop_start_index; i++) {
@@ -550,7 +4333,7 @@ public:
     TranslationBlock translateNestedInner() {
         TranslationBlock tb;
         tb.tb_id = current_tb_id++;
-        tb.start_label = "NESTED_STATE_1";
+        tb.label_sym = sym_nested_state_1;
         
         cout << "  Translating inner loop body into TB" << tb.tb_id << " (kernel only):" << endl;
         
@@ -600,7 +4383,7 @@ public:
     TranslationBlock translateNestedOverlap() {
         TranslationBlock tb;
         tb.tb_id = current_tb_id++;
-        tb.start_label = "NESTED_STATE_2";
+        tb.label_sym = sym_nested_state_2;
         
         cout << "  Translating overlap section with SPMASK into TB" << tb.tb_id << ":" << endl;
         for (size_t i = 10; i < guest_code.size(); i++) {
@@ -663,6 +4446,8 @@ public:
         cout << "VLIW DBT COMPLETE SIMULATION" << endl;
         cout << "======================================\n" << endl;
         
+        printMemoryMap();
+        
         cout << "\n********** PART 1: Figure 1 Assembly Code **********\n" << endl;
         parseGuestCode();
         
@@ -672,8 +4457,9 @@ public:
         int start_ep_tb1 = getNextStartEP();
         int initial_cycles = 1000;
         TranslationBlock tb1 = translateWithConstraint(start_ep_tb1, initial_cycles);
-        translation_blocks.push_back(tb1);
+        registerTB(tb1);
         
+        executeTB(tb1.tb_id);
         cout << "\n--- After TB0 execution ---" << endl;
         int cycles_for_tb2 = getCyclesFromPrecedingTB();
         cout << "Minimum remaining delay from TB0: " << cycles_for_tb2 << " cycles" << endl;
@@ -681,11 +4467,13 @@ public:
         cout << "\n--- Translating TB1 ---" << endl;
         int start_ep_tb2 = getNextStartEP();
         TranslationBlock tb2 = translateWithConstraint(start_ep_tb2, cycles_for_tb2);
-        translation_blocks.push_back(tb2);
+        registerTB(tb2);
 
 
         
        
+        chainTB(tb1.tb_id, tb2.tb_id);
+        executeTB(tb2.tb_id);
         cout << "\n--- After TB1 execution ---" << endl;
         int cycles_for_tb3 = getCyclesFromPrecedingTB();
         cout << "Minimum remaining delay from TB1: " << cycles_for_tb3 << " cycles" << endl;
@@ -694,7 +4482,8 @@ public:
         if (next_ep_index < guest_code.size()) {
                 cout << "\n--- Translating TB2 (remaining instructions) ---" << endl;
                 TranslationBlock tb3 = translateWithConstraint(next_ep_index, cycles_for_tb3);
-                translation_blocks.push_back(tb3);
+                registerTB(tb3);
+                chainTB(tb2.tb_id, tb3.tb_id);
         } else {
                 cout << "\n--- No more EPs to translate ---" << endl;
         }
@@ -802,12 +4591,1145 @@ public:
         
         cout << "\n========== Nested Loop Simulation Complete ==========\n" << endl;
         cout << "Total Translation Blocks generated: " << translation_blocks.size() << endl;
+        
+        compactCodeCache();
+        
+        cout << "\n\n********** PART 5: Semihosting **********\n" << endl;
+        const char message[] = "Hello from the guest via semihosting\n";
+        uint32_t message_addr = 0x00800000;
+        uint8_t* message_host = hostAddress(message_addr, sizeof(message), true);
+        if (message_host) memcpy(message_host, message, sizeof(message));
+        registers["A4"] = SYS_WRITE;
+        registers["B4"] = 1;
+        registers["A6"] = message_addr;
+        registers["B6"] = sizeof(message) - 1;
+        int swe_tb = translateSemihostCall();
+        cout << "Executing TB" << swe_tb << " (SWE): SYS_WRITE(1, 0x" << hex << message_addr << dec
+             << ", " << registers["B6"] << ")" << endl;
+        executeTB(swe_tb);
+        cout << "Trap returned A4=" << registers["A4"] << " (buffered until flush)" << endl;
+        registers["A4"] = SYS_FLUSH;
+        registers["B4"] = 1;
+        executeTB(swe_tb);
+        
+        if (sample_fifo.active()) {
+            streamSamples();
+        }
+        
+        cout << "\n\n********** PART 6: EDMA3 Transfer Overlapping Kernel Execution **********\n" << endl;
+        simulateEdmaPingPong();
+        
+        cout << "\n\n********** PART 7: Lazy TIMER64 and Interrupts **********\n" << endl;
+        simulateTimerInterrupts();
+        
+        cout << "\n\n********** PART 8: Interrupts During SPLOOP **********\n" << endl;
+        simulateSploopInterrupt();
+    }
+    
+    // PART 10 onwards; main runs the multi-core PART 9 in between
+    void simulateExtensions() {
+        cout << "\n\n********** PART 10: Breakpoints and Watchpoints **********\n" << endl;
+        simulateDebugging();
+        
+        cout << "\n\n********** PART 11: Precise State on Guest Faults **********\n" << endl;
+        simulatePreciseFault();
+        
+        cout << "\n\n********** PART 12: On-Stack Replacement into the SPLOOP Kernel **********\n" << endl;
+        simulateOsr();
+        
+        cout << "\n\n********** PART 13: Predecoded Threaded Interpreter **********\n" << endl;
+        simulateInterpreter();
+        
+        cout << "\n\n********** PART 14: Jump Cache on Unchained Exits **********\n" << endl;
+        simulateJumpCache();
+        
+        cout << "\n\n********** PART 15: Exact Cycle Budgets **********\n" << endl;
+        simulateCycleBudgets();
+        
+        cout << "\n\n********** PART 16: Guest Registers Cached Across Chained TBs **********\n" << endl;
+        simulateRegisterCaching();
+        
+        cout << "\n\n********** PART 17: Register Renaming in the SPLOOP Kernel **********\n" << endl;
+        simulateKernelRenaming();
+        
+        cout << "\n\n********** PART 18: SPLOOP Vectorization **********\n" << endl;
+        simulateVectorization();
+        
+        cout << "\n\n********** PART 19: Host Threads for Long SPLOOPs **********\n" << endl;
+        simulateParallelSploop();
+        
+        cout << "\n\n********** PART 20: Memory-Range Guards **********\n" << endl;
+        simulateRangeGuards();
+        
+        cout << "\n\n********** PART 21: Speculation and Deoptimization **********\n" << endl;
+        simulateSpeculation();
+        
+        cout << "\n\n********** PART 22: Value Profiling and Specialization **********\n" << endl;
+        simulateValueProfiling();
+    }
+
+    // Figure 1's EP12-13 (MV A10, A2; ADD A4, A2, A4) entered with A10 fixed
+    // and A4 changing on every call, then with A10 changed
+    void simulateValueProfiling() {
+        parseGuestCode();
+        TranslationBlock generic = translateWithConstraint(11, 2);
+        registerTB(generic);
+        int site = generic.tb_id;
+        int saved_a10 = registers["A10"], saved_a4 = registers["A4"];
+        value_profiling = true;
+        profiled_regs = {"A4", "A10", "B1"};
+        uint64_t folded_before = folded_operands;
+        
+        cout << "\nProfiling live-ins of TB" << site << ":";
+        for (int reg : translation_blocks[site].live_in) cout << " " << guestRegisterName(reg);
+        cout << endl;
+        printTBBody(site);
+        
+        auto phase = [&](int a10, int runs) {
+            uint64_t deopts_before = deopts;
+            for (int i = 0; i < runs; i++) {
+                registers["A10"] = a10;
+                registers["A4"] = i * 3;
+                executeTB(site);
+            }
+            int current = translation_blocks[site].specialized;
+            cout << "A10=" << a10 << ", A4 varying: " << runs << " runs, " << (deopts - deopts_before) << " deopts; "
+                 << (current < 0 ? "running the generic TB" : "specialized on A10 as TB" + to_string(current))
+                 << endl;
+            if (current >= 0) printTBBody(current);
+        };
+        phase(12, 24);
+        phase(100, 8);
+        cout << "Value specializations: " << value_specializations << ", operands folded: " << (folded_operands - folded_before) << endl;
+        
+        value_profiling = false;
+        registers["A10"] = saved_a10;
+        registers["A4"] = saved_a4;
+    }
+
+    void printTBBody(int tb_id) {
+        cout << "  TB" << tb_id << ":";
+        for (const auto& ep : translation_blocks[tb_id].packets) {
+            for (const auto& insn : ep.instructions) {
+                cout << "  " << (insn.predicate.empty() ? "" : insn.predicate + " ") << insn.mnemonic << " "
+                     << insn.operands << ";";
+            }
+        }
+        cout << endl;
+    }
+
+    // Figure 1's EP6 ([B1] SUB || [B1] B LOOP) specialized for B1 != 0 and
+    // B1 == 3, then run while each assumption in turn stops holding
+    void simulateSpeculation() {
+        parseGuestCode();
+        TranslationBlock generic = translateWithConstraint(5, 1);
+        registerTB(generic);
+        int site = generic.tb_id;
+        int saved_b1 = registers["B1"];
+        
+        int spec = specializeTB(site, {{SPEC_PREDICATE, "B1", 1}, {SPEC_VALUE, "B1", 3}});
+        cout << "\nGeneric TB" << site << ": " << translation_blocks[site].host_size << " host bytes; specialized TB"
+             << spec << ": " << translation_blocks[spec].host_size << " host bytes" << endl;
+        printTBBody(site);
+        printTBBody(spec);
+        
+        auto specializedRuns = [&]() {
+            uint64_t runs = 0;
+            for (const auto& tb : translation_blocks) {
+                if (tb.generic_tb == site) runs += tb.exec_count;
+            }
+            return runs;
+        };
+        auto phase = [&](int b1, int runs) {
+            registers["B1"] = b1;
+            uint64_t spec_before = specializedRuns(), deopts_before = deopts;
+            for (int i = 0; i < runs; i++) executeTB(site);
+            cout << "B1=" << b1 << ": " << runs << " runs, " << (specializedRuns() - spec_before)
+                 << " specialized, " << (deopts - deopts_before) << " deopts; now assuming:";
+            int current = translation_blocks[site].specialized;
+            if (current < 0) cout << " nothing (generic TB)";
+            else {
+                for (const auto& g : translation_blocks[current].guards) {
+                    cout << " " << g.reg << (g.kind == SPEC_PREDICATE ? (g.expected ? "!=0" : "==0")
+                                                                        : "==" + to_string(g.expected));
+                }
+                cout << " (TB" << current << ")";
+            }
+            cout << endl;
+        };
+        phase(3, 10);
+        phase(5, 6);
+        phase(0, 6);
+        cout << "Retranslations after repeated guard failures: " << spec_retranslations << endl;
+        
+        registers["B1"] = saved_b1;
+    }
+
+    // The biased copy with the destination placed apart from, on top of, and
+    // just ahead of or behind the source. Each layout runs scalar and with
+    // vectorization allowed from the same input; the guard must send the
+    // overlapping ones down the scalar body.
+    void simulateRangeGuards() {
+        parseBiasedCopyLoop();
+        const uint32_t src = 0x80100000;
+        const int iterations = (64 << 10) + 3;
+        const int span = iterations + 8;  // Words touched by any layout
+        struct Layout { const char* name; uint32_t dst; };
+        const Layout layouts[] = {
+            {"disjoint", 0x80800000}, {"in place", src}, {"dst = src + 16", src + 16}, {"dst = src - 16", src - 16}
+        };
+        if (!mappedForDemo(src - 32, (size_t)span * 4)) return;
+        uint32_t* window = (uint32_t*)hostAddress(src - 32, (size_t)span * 4);
+        for (const Layout& layout : layouts) {
+            vector<uint32_t> results[2];
+            vector<uint32_t> out_words[2];
+            uint64_t checks = 0, failures = 0;
+            if (!mappedForDemo(layout.dst, (size_t)iterations * 4)) continue;
+            uint32_t* out = (uint32_t*)hostAddress(layout.dst, (size_t)iterations * 4);
+            for (int pass = 0; pass < 2; pass++) {
+                vectorize_sploop = pass == 1;
+                predecoded.image = -1;
+                predecodeImage();
+                for (int i = 0; i < span; i++) window[i] = (uint32_t)i * 2654435761u;
+                if (out < window || out >= window + span) memset(out, 0, (size_t)iterations * 4);
+                registers["A4"] = (int)src;
+                registers["B4"] = (int)layout.dst;
+                registers["A6"] = 3;
+                ILC = iterations;
+                interpret(sploop_start_index, UINT64_MAX);
+                results[pass] = {(uint32_t)registers["A4"], (uint32_t)registers["B4"], (uint32_t)registers["A7"]};
+                out_words[pass].assign(out, out + iterations);
+                checks = predecoded.vector_guard.checks;
+                failures = predecoded.vector_guard.failures;
+            }
+            bool same = results[0] == results[1] && out_words[0] == out_words[1];
+            cout << left << setw(16) << layout.name << right << "guard " << (failures ? "failed" : "passed")
+                 << " (" << checks << " check" << (checks == 1 ? "" : "s") << "), "
+                 << (failures ? "scalar body" : "vectorized") << ", results "
+                 << (same ? "match scalar" : "MISMATCH") << endl;
+        }
+        vectorize_sploop = true;
+        predecoded.image = -1;
+    }
+
+    // A 64MB Figure 4 copy on one host thread and split across the pool. The
+    // pool gets at least 4 threads so the split runs even on a 1-CPU host.
+    void simulateParallelSploop() {
+        parseSoftwarePipelinedLoop();
+        predecodeImage();
+        const uint32_t src = 0x80000000, dst = 0x84000000;
+        const int words = 16 << 20;
+        if (!mappedForDemo(src, (size_t)words * 4) || !mappedForDemo(dst, (size_t)words * 4)) return;
+        uint32_t* in = (uint32_t*)hostAddress(src, (size_t)words * 4);
+        uint32_t* out = (uint32_t*)hostAddress(dst, (size_t)words * 4);
+        for (int i = 0; i < words; i++) in[i] = (uint32_t)i * 668265263u;
+        
+        int configured = host_threads;
+        int pool_threads = max(4, configured > 0 ? configured : (int)thread::hardware_concurrency());
+        vector<int> reference_regs;
+        for (int threads : {1, pool_threads}) {
+            host_threads = threads;
+            memset(out, 0, (size_t)words * 4);
+            registers["A1"] = (int)src;
+            registers["B0"] = (int)dst;
+            ILC = words;
+            uint64_t split_before = parallel_trips;
+            
+            double start = wallSeconds();
+            InterpResult r = interpret(sploop_start_index, UINT64_MAX);
+            double secs = wallSeconds() - start;
+            
+            vector<int> regs = {registers["A1"], registers["B0"], registers["B2"], ILC};
+            bool same = memcmp(in, out, (size_t)words * 4) == 0;
+            if (reference_regs.empty()) reference_regs = regs;
+            same = same && regs == reference_regs;
+            cout << threads << (threads == 1 ? " thread:  " : " threads: ") << r.insns << " insns, "
+                 << (parallel_trips - split_before) * kVectorLanes << " iterations split, " << fixed
+                 << setprecision(3) << secs << "s wall" << defaultfloat << ", B2=0x" << hex << registers["B2"]
+                 << dec << (same ? "" : "  MISMATCH") << endl;
+        }
+        cout << "Host CPUs: " << thread::hardware_concurrency() << endl;
+        host_threads = configured;
+    }
+
+    // Biased copy with a trip count that leaves a scalar remainder, scalar and
+    // vectorized; memory and registers must match
+    void simulateVectorization() {
+        parseBiasedCopyLoop();
+        const uint32_t src = 0x80000000, dst = 0x84000000;
+        const int iterations = (1 << 20) + 5;
+        if (!mappedForDemo(src, (size_t)iterations * 4) || !mappedForDemo(dst, (size_t)iterations * 4)) return;
+        uint32_t* in = (uint32_t*)hostAddress(src, (size_t)iterations * 4);
+        uint32_t* out = (uint32_t*)hostAddress(dst, (size_t)iterations * 4);
+        for (int i = 0; i < iterations; i++) in[i] = (uint32_t)i * 2246822519u;
+        
+        vector<uint32_t> reference;
+        vector<int> reference_regs;
+        for (int pass = 0; pass < 3; pass++) {
+            vectorize_sploop = pass > 0;
+            uint64_t slice = pass == 2 ? 1003 : UINT64_MAX;
+            predecoded.image = -1;
+            predecodeImage();
+            memset(out, 0, (size_t)iterations * 4);
+            registers["A4"] = (int)src;
+            registers["B4"] = (int)dst;
+            registers["A6"] = 1000;
+            ILC = iterations;
+            uint64_t vector_before = vector_iterations;
+            
+            double start = threadCpuSeconds();
+            int ep = sploop_start_index;
+            uint64_t insns = 0;
+            InterpResult r;
+            do {
+                r = interpret(ep, slice, r.pending);
+                ep = r.ep_index;
+                insns += r.insns;
+            } while (r.status == INTERP_BUDGET);
+            double secs = threadCpuSeconds() - start;
+            
+            vector<int> regs = {registers["A4"], registers["B4"], registers["A5"], registers["A7"], ILC};
+            bool same = true;
+            if (pass == 0) {
+                reference.assign(out, out + iterations);
+                reference_regs = regs;
+            } else {
+                same = memcmp(out, reference.data(), (size_t)iterations * 4) == 0 && regs == reference_regs;
+            }
+            string label = string(pass ? "Vectorized" : "Scalar") + (slice == UINT64_MAX ? ", one call:" : ", 1003-cycle slices:");
+            cout << left << setw(32) << label << right << insns << " insns, " << (vector_iterations - vector_before) << " iterations in 8-lane trips, "
+                 << fixed << setprecision(3) << secs << "s CPU (" << setprecision(1) << (insns / secs / 1e6)
+                 << "M insns/s)" << defaultfloat << ", A7=0x" << hex << registers["A7"] << dec
+                 << (same ? "" : "  MISMATCH") << endl;
+        }
+        vectorize_sploop = true;
+        predecoded.image = -1;
+    }
+
+    // Figure 4 copy loop with and without renaming, once in one call and once
+    // in small cycle slices so the interpreter stops inside the body; the
+    // copies and the final B2 must agree
+    void simulateKernelRenaming() {
+        const uint32_t src = 0x80000000, dst = 0x82000000;
+        const int words = 1 << 20;
+        if (!mappedForDemo(src, (size_t)words * 4) || !mappedForDemo(dst, (size_t)words * 4)) return;
+        uint32_t* in = (uint32_t*)hostAddress(src, (size_t)words * 4);
+        uint32_t* out = (uint32_t*)hostAddress(dst, (size_t)words * 4);
+        for (int i = 0; i < words; i++) in[i] = (uint32_t)i * 40503u + 7;
+        
+        vector<uint32_t> reference;
+        int reference_b2 = 0;
+        vectorize_sploop = false;
+        for (int pass = 0; pass < 4; pass++) {
+            bool rename = pass < 2;
+            uint64_t slice = (pass % 2) ? 1003 : UINT64_MAX;
+            rename_kernel_moves = rename;
+            predecoded.image = -1;  // Re-predecode with the new setting
+            predecodeImage();
+            memset(out, 0, (size_t)words * 4);
+            registers["A1"] = (int)src;
+            registers["B0"] = (int)dst;
+            registers["B2"] = -1;
+            ILC = words;
+            
+            double start = threadCpuSeconds();
+            int ep = sploop_start_index;
+            uint64_t insns = 0;
+            InterpResult r;
+            do {
+                r = interpret(ep, slice, r.pending);
+                ep = r.ep_index;
+                insns += r.insns;
+            } while (r.status == INTERP_BUDGET);
+            double secs = threadCpuSeconds() - start;
+            
+            bool same = true;
+            if (pass == 0) {
+                reference.assign(out, out + words);
+                reference_b2 = registers["B2"];
+            } else {
+                same = memcmp(out, reference.data(), (size_t)words * 4) == 0 && registers["B2"] == reference_b2;
+            }
+            cout << (rename ? "Renamed:  " : "Literal:  ") << (predecoded.ops.size() - 1) << " ops, "
+                 << (slice == UINT64_MAX ? "one call" : "1003-cycle slices") << ", " << insns << " insns in "
+                 << fixed << setprecision(3) << secs << "s CPU" << defaultfloat << ", B2=0x" << hex
+                 << registers["B2"] << dec << (same ? "" : "  MISMATCH") << endl;
+        }
+        rename_kernel_moves = true;
+        vectorize_sploop = true;
+        predecoded.image = -1;
+    }
+
+    // The Figure 4 state 0 TB chained into its kernel TB: the pair shares one
+    // allocation, so kernel iterations do no guest register loads or stores
+    void simulateRegisterCaching() {
+        parseSoftwarePipelinedLoop();
+        TranslationBlock tb0 = translateNormalLoop();
+        registerTB(tb0);
+        TranslationBlock tb1 = translateKernelLoop();
+        registerTB(tb1);
+        chainTB(tb0.tb_id, tb1.tb_id);
+        
+        static const char* kHostRegNames[kHostRegs] = {"rbx", "rbp", "r12", "r13", "r14", "r15"};
+        const TranslationBlock& kernel = translation_blocks[tb1.tb_id];
+        cout << "Chain group TB" << tb0.tb_id << " -> TB" << tb1.tb_id << " caches:";
+        for (size_t i = 0; i < kernel.cached_regs.size(); i++) {
+            cout << " " << guestRegisterName(kernel.cached_regs[i]) << "->" << kHostRegNames[i];
+        }
+        cout << endl;
+        
+        uint64_t fills = reg_fills, spills = reg_spills, accesses = reg_boundary_accesses;
+        uint64_t baseline = reg_uncached_baseline;
+        last_tb = -1;
+        executeTB(tb0.tb_id);
+        ILC = 63;
+        active_kernel_tb = tb1.tb_id;
+        while (ILC > 0) {
+            ILC--;
+            executeTB(tb1.tb_id);
+        }
+        active_kernel_tb = -1;
+        writeBackCachedRegisters();  // Unchained exit from the loop
+        live_group = -1;
+        
+        cout << "64 iterations: " << (reg_fills - fills) << " fills, " << (reg_spills - spills)
+             << " spills, " << (reg_boundary_accesses - accesses) << " other register loads/stores"
+             << " (" << (reg_uncached_baseline - baseline) << " without caching)" << endl;
+    }
+
+    // Run Figure 1 for exact cycle counts, continuing where the last budget
+    // stopped; the TBs are the ones translated for the jump cache demo
+    void simulateCycleBudgets() {
+        const uint64_t budgets[] = {1000, 1001, 12345, 7, 3, 100};
+        uint32_t pc = 0;
+        for (uint64_t budget : budgets) {
+            // The last budget starts with the timer interrupt pending; its ISR
+            // is taken at the first boundary and charged to the same budget
+            bool with_interrupt = budget == budgets[5];
+            uint16_t ier_before = intc.ier;
+            uint64_t isr_before = intc.taken[InterruptController::kTimerInt];
+            if (with_interrupt) {
+                intc.ier |= 1u << InterruptController::kTimerInt;
+                intc.raise(InterruptController::kTimerInt);
+            }
+            uint64_t start = global_cycle, slow_before = slow_path_eps;
+            cycle_budget = (int64_t)budget;
+            int tbs = 0;
+            while (true) {
+                int tb_id = partial_tb;
+                bool completed;
+                if (tb_id >= 0) {
+                    completed = finishPartialTB();
+                } else {
+                    tb_id = lookupTB(pc);
+                    if (tb_id < 0) {
+                        TranslationBlock tb = translateWithConstraint(pc / kFetchPacketBytes, 1000);
+                        registerTB(tb);
+                        tb_id = tb.tb_id;
+                    }
+                    completed = runTBBudgeted(tb_id);
+                }
+                if (!completed) break;
+                tbs++;
+                pc = fallThroughPC(tb_id);
+            }
+            cout << "Budget " << budget << ": ran " << (global_cycle - start) << " cycles, " << tbs
+                 << " TBs whole, " << (slow_path_eps - slow_before) << " EPs on the slow path";
+            if (with_interrupt) {
+                uint64_t isrs = intc.taken[InterruptController::kTimerInt] - isr_before;
+                cout << ", " << isrs << " ISR (" << isrs * InterruptController::kIsrCycles << " cycles) included";
+                intc.ier = ier_before;
+            }
+            if (partial_tb >= 0) {
+                cout << ", paused in TB" << partial_tb << " before EP"
+                     << translation_blocks[partial_tb].packets[partial_pos].ep_num;
+            }
+            cout << endl;
+        }
+    }
+
+    // Dispatch Figure 1 TB by TB without chaining, so every exit looks its
+    // successor up by guest PC; TBs are translated on their first miss
+    void simulateJumpCache() {
+        const int steps = 300000;
+        uint32_t pc = 0;
+        uint64_t hits_before = jump_cache.hits, misses_before = jump_cache.misses;
+        for (int i = 0; i < steps; i++) {
+            int tb_id = lookupTB(pc);
+            if (tb_id < 0) {
+                TranslationBlock tb = translateWithConstraint(pc / kFetchPacketBytes, 1000);
+                registerTB(tb);
+                tb_id = tb.tb_id;
+            }
+            executeTB(tb_id);
+            pc = fallThroughPC(tb_id);
+        }
+        cout << "\n" << steps << " unchained exits: " << (jump_cache.hits - hits_before) << " jump cache hits, "
+             << (jump_cache.misses - misses_before) << " misses" << endl;
+        
+        // Cost of one exit lookup through each path
+        const int lookups = 10000000;
+        vector<uint32_t> pcs;
+        for (const auto& entry : tb_index) pcs.push_back(entry.first);
+        int sink = 0;
+        double start = threadCpuSeconds();
+        for (int i = 0; i < lookups; i++) sink += lookupTB(pcs[i % pcs.size()]);
+        double cached = threadCpuSeconds() - start;
+        start = threadCpuSeconds();
+        for (int i = 0; i < lookups; i++) sink += tb_index.find(pcs[i % pcs.size()])->second;
+        double indexed = threadCpuSeconds() - start;
+        cout << "Per lookup: " << fixed << setprecision(1) << (cached / lookups * 1e9) << "ns via jump cache, "
+             << (indexed / lookups * 1e9) << "ns via the TB index" << defaultfloat
+             << (sink == 42 ? " " : "") << endl;
+    }
+
+    // Wall-clock time, for runs spread over several host threads
+    static double wallSeconds() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    // Thread CPU time, so measurements do not depend on host load
+    static double threadCpuSeconds() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    // Demo buffers must be mapped guest RAM, which a small --ddr-mb may not cover
+    bool mappedForDemo(uint32_t addr, size_t bytes) {
+        if (hostAddress(addr, bytes)) return true;
+        cout << "0x" << hex << addr << dec << " (" << (bytes >> 10) << " KB) is not mapped guest RAM, skipping" << endl;
+        return false;
+    }
+
+    // A one-EP TB holding a lone SWE, placed past the end of the image so no
+    // guest breakpoint or PC lookup can land on it
+    int translateSemihostCall() {
+        ExecutePacket ep;
+        ep.ep_num = (int)guest_code.size() + 1;
+        ep.cycles = 1;
+        ep.instructions = {createInstruction(SEMIHOST, "SWE", "", 0, "", ep.ep_num)};
+        TranslationBlock tb;
+        tb.tb_id = current_tb_id++;
+        tb.max_cycles = 1;
+        tb.start_ep_index = tb.end_ep_index = (int)guest_code.size();
+        tb.packets = {ep};
+        registerTB(tb);
+        return tb.tb_id;
     }
+
+    // SWE write and flush run by the interpreter; the caller sets up the
+    // SYS_WRITE arguments
+    void parseSemihostProgram() {
+        guest_code.clear();
+        sploop_start_index = -1;
+        addEP(1, 1, createInstruction(SEMIHOST, "SWE", "", 0, "", 1));
+        vector<Instruction> flush_args = {
+            createInstruction(ARITHMETIC, "MVK", ".S1", 0, to_string(SYS_FLUSH) + ", A4", 2),
+            createInstruction(ARITHMETIC, "MVK", ".S2", 0, "1, B4", 3, "", true)
+        };
+        addEP(2, 1, flush_args);
+        addEP(3, 1, createInstruction(SEMIHOST, "SWE", "", 0, "", 4));
+        resolveSymbols();
+    }
+
+    // Run the Figure 4 copy loop (LDW/MV/STW) in the interpreter over 16MB of
+    // DDR and check the copy
+    void simulateInterpreter() {
+        const uint32_t src = 0x80000000, dst = 0x81000000;
+        const int words = 4 << 20;
+        if (!mappedForDemo(src, (size_t)words * 4) || !mappedForDemo(dst, (size_t)words * 4)) return;
+        uint32_t* in = (uint32_t*)hostAddress(src, (size_t)words * 4);
+        for (int i = 0; i < words; i++) in[i] = (uint32_t)i * 2654435761u;
+        
+        // Measure the scalar dispatch loop; later PARTs get vectorization and a
+        // fresh predecode back however this one returns
+        struct RestoreVectorizer {
+            VLIWSimulator* sim;
+            ~RestoreVectorizer() {
+                sim->vectorize_sploop = true;
+                sim->predecoded.image = -1;
+            }
+        } restore{this};
+        vectorize_sploop = false;
+        predecodeImage();
+        cout << "Predecoded " << guest_code.size() << " EPs into " << predecoded.ops.size()
+             << " ops (" << sizeof(DecodedOp) << " bytes each)" << endl;
+        registers["A1"] = (int)src;
+        registers["B0"] = (int)dst;
+        ILC = words;
+        double start = threadCpuSeconds();
+        InterpResult r = interpret(sploop_start_index, UINT64_MAX);
+        double secs = threadCpuSeconds() - start;
+        
+        const uint32_t* out = (const uint32_t*)hostAddress(dst, (size_t)words * 4);
+        bool match = memcmp(in, out, (size_t)words * 4) == 0;
+        cout << "Interpreted " << r.insns << " guest instructions (" << r.cycles << " cycles), stopped at EP"
+             << (r.ep_index + 1) << ", copy " << (match ? "verified" : "MISMATCH") << endl;
+        cout << "Time: " << fixed << setprecision(3) << secs << "s CPU" << defaultfloat << endl;
+        cout << "Throughput: " << fixed << setprecision(1) << (r.insns / secs / 1e6) << "M guest insns/s"
+             << defaultfloat << endl;
+        
+        // Figure 1 runs without translation too; its LOOP branches keep
+        // reissuing each other, so it runs until the cycle budget
+        parseGuestCode();
+        registers["B1"] = 5;
+        r = interpret(0, 100000);
+        cout << "Figure 1: " << r.insns << " instructions in " << r.cycles << " cycles, B1="
+             << registers["B1"] << (r.status == INTERP_EXIT ? ", left through B B3" : ", cycle budget reached")
+             << endl;
+        
+        // Again in 1003-cycle slices: the LOOP branch in flight at each stop
+        // must still be taken after the resume
+        map<string, int> one_call = registers;
+        uint64_t one_call_insns = r.insns, one_call_cycles = r.cycles;
+        parseGuestCode();
+        registers["B1"] = 5;
+        InterpResult slice;
+        uint64_t sliced_insns = 0, sliced_cycles = 0;
+        int slices = 0;
+        do {
+            slice = interpret(slice.ep_index, min<uint64_t>(1003, 100000 - sliced_cycles), slice.pending);
+            sliced_insns += slice.insns;
+            sliced_cycles += slice.cycles;
+            slices++;
+        } while (slice.status == INTERP_BUDGET && sliced_cycles < 100000);
+        bool same = registers == one_call && sliced_insns == one_call_insns && sliced_cycles == one_call_cycles;
+        cout << "Figure 1 in " << slices << " slices: " << sliced_insns << " instructions in " << sliced_cycles
+             << " cycles, B1=" << registers["B1"] << (same ? ", matches one call" : "  MISMATCH") << endl;
+        
+        // SWE traps from interpreted code
+        const char message[] = "Hello from interpreted code via SWE\n";
+        const uint32_t message_addr = 0x00800100;
+        uint8_t* host = hostAddress(message_addr, sizeof(message), true);
+        if (!host) {
+            cout << "L2SRAM not mapped, skipping the SWE run" << endl;
+            return;
+        }
+        memcpy(host, message, sizeof(message));
+        parseSemihostProgram();
+        registers["A4"] = SYS_WRITE;
+        registers["B4"] = 1;
+        registers["A6"] = message_addr;
+        registers["B6"] = sizeof(message) - 1;
+        r = interpret(0, UINT64_MAX);
+        cout << "SWE program: " << r.insns << " instructions, A4=" << registers["A4"] << " after the flush" << endl;
+    }
+
+    // A single long run of the Figure 4 loop, loaded fresh so nothing is
+    // translated yet
+    void simulateOsr() {
+        parseSoftwarePipelinedLoop();
+        ILC = 1000;
+        cout << "Interpreting SPLOOP with ILC=" << ILC << endl;
+        uint64_t start = global_cycle;
+        uint64_t eps_before = interpreted_eps;
+        runSploopTiered();
+        int kernel_tb = tb_by_label[sym_loop_state_1];
+        cout << "Loop completed in " << (global_cycle - start) << " cycles: "
+             << (interpreted_eps - eps_before) << " EPs interpreted, TB" << kernel_tb << " executed "
+             << translation_blocks[kernel_tb].exec_count << " times" << endl;
+    }
+
+    // Replay the Figure 4 kernel TB's memory accesses in emitted order with B0
+    // pointing at unmapped memory; the deferred STW faults after everything
+    // else in its EP has retired
+    void simulatePreciseFault() {
+        const TranslationBlock& tb0 = translation_blocks[0];
+        size_t bytes = 0;
+        for (const auto& tb : translation_blocks) {
+            bytes += tb.state_map.size() * sizeof(StateMapEntry) + tb.pending_results.size() * sizeof(PendingResult)
+                   + tb.pending_begin.size() * sizeof(int);
+        }
+        cout << "Side tables for " << translation_blocks.size() << " TBs: " << bytes << " bytes" << endl;
+        
+        int ep6_pos = (int)tb0.packets.size() - 1;
+        for (int pos = 0; pos < (int)tb0.state_map.size(); pos++) {
+            if (tb0.state_map[pos].ep_pos == ep6_pos) {
+                PreciseState st = reconstructState(tb0, pos);
+                cout << "TB0 at EP" << (st.ep_index + 1) << ": " << st.pending.size()
+                     << " branches in flight, nearest lands in " << st.pending.front().remaining_delay
+                     << " cycle(s)" << endl;
+                break;
+            }
+        }
+        
+        int kernel_tb = tb_by_label[sym_loop_state_1];
+        const TranslationBlock& tb = translation_blocks[kernel_tb];
+        const uint32_t a1 = 0x80000000, b0 = 0x40000000;  // B0 is unmapped
+        for (int pos = 0; pos < (int)tb.state_map.size(); pos++) {
+            const Instruction& insn = tb.packets[tb.state_map[pos].ep_pos].instructions[tb.state_map[pos].insn];
+            uint32_t value = 0;
+            bool ok = true;
+            if (insn.type == LOAD) ok = guestLoad32(a1, value);
+            if (insn.type == STORE) ok = guestStore32(b0, value);
+            if (!ok) {
+                guestFault(kernel_tb, tb.host_offset + pos * CodeCache::kHostBytesPerInsn,
+                           insn.type == STORE ? b0 : a1);
+                break;
+            }
+        }
+    }
+
+    // Break on the first EP of the nested inner kernel, which retranslates only
+    // that TB, then watch a DDR word so its page drops out of the TLB
+    void simulateDebugging() {
+        int inner_tb = tb_by_label[sym_nested_state_1];
+        int bp_ep = translation_blocks[inner_tb].packets.front().ep_num - 1;
+        cout << "Setting breakpoint at EP" << (bp_ep + 1) << " (PC 0x" << hex << bp_ep * kFetchPacketBytes
+             << dec << ")" << endl;
+        setBreakpoint(bp_ep);
+        for (int i = 0; i < 3; i++) {
+            executeTB(inner_tb);  // Entered through the stale TB ID
+        }
+        removeBreakpoint(bp_ep);
+        executeTB(inner_tb);
+        
+        const uint32_t watched = 0x80200000;
+        uint32_t value = 0;
+        for (int i = 0; i < 64; i++) {
+            guestLoad32(watched + 4 * i, value);
+        }
+        uint64_t misses_before = tlb.misses;
+        cout << "Setting write watchpoint on 0x" << hex << watched << dec << endl;
+        setWatchpoint(watched, 4, WATCH_WRITE);
+        for (int i = 0; i < 64; i++) {
+            guestStore32(watched + 4 * i, i);
+        }
+        executeTB(tb_by_label[sym_loop_state_1]);  // Stop is reported at the TB boundary
+        cout << "64 stores to the watched page: " << (tlb.misses - misses_before) << " TLB misses" << endl;
+        removeWatchpoint(watched, 4, WATCH_WRITE);
+        misses_before = tlb.misses;
+        for (int i = 0; i < 64; i++) {
+            guestStore32(watched + 4 * i, i);
+        }
+        cout << "After removing it: " << (tlb.misses - misses_before) << " TLB misses" << endl;
+    }
+
+    // Re-enter the Figure 4 kernel with a fast timer so interrupts land between
+    // kernel iterations
+    void simulateSploopInterrupt() {
+        int kernel_tb = tb_by_label[sym_loop_state_1];
+        size_t tbs_before = translation_blocks.size();
+        guestStore32(Timer64::kBase + Timer64::kPRDLO, 10);
+        guestStore32(Timer64::kBase + Timer64::kCNTLO, 0);
+        guestStore32(Timer64::kBase + Timer64::kTCR, Timer64::CONTINUOUS << 6);
+        
+        ILC = 16;
+        state = 1;
+        cout << "Running kernel TB" << kernel_tb << " with ILC=" << ILC << ", TIMER64 period 10 ticks" << endl;
+        runSploopKernel(kernel_tb, "Iteration", "Executing", "state 1 - kernel only");
+        state = 0;
+        guestStore32(Timer64::kBase + Timer64::kTCR, Timer64::DISABLED << 6);
+        
+        cout << "Loop completed with ILC=" << ILC << ", TBs translated during loop: "
+             << (translation_blocks.size() - tbs_before) << endl;
+    }
+
+    // Continuous timer with a short period while the kernel TB runs; interrupts
+    // are only taken at TB boundaries.
+    void simulateTimerInterrupts() {
+        const uint32_t period = 100;
+        const int runs = 500;
+        intc.ier |= 1u << InterruptController::kTimerInt;
+        guestStore32(Timer64::kBase + Timer64::kPRDLO, period);
+        guestStore32(Timer64::kBase + Timer64::kCNTLO, 0);
+        guestStore32(Timer64::kBase + Timer64::kTCR, Timer64::CONTINUOUS << 6);
+        
+        int kernel_tb = tb_by_label[sym_loop_state_1];
+        uint64_t start = global_cycle;
+        cout << "TIMER64 started at cycle " << start << " (period " << period << " ticks, CPU/"
+             << Timer64::kPrescale << ")" << endl;
+        for (int i = 0; i < runs; i++) {
+            executeTB(kernel_tb);
+            if (i % 200 == 0) {
+                uint32_t cnt = 0;
+                guestLoad32(Timer64::kBase + Timer64::kCNTLO, cnt);
+                cout << "  cycle " << global_cycle << ": CNTLO=" << cnt << endl;
+            }
+        }
+        guestStore32(Timer64::kBase + Timer64::kTCR, Timer64::DISABLED << 6);
+        cout << "Executed TB" << kernel_tb << " " << runs << " times (" << (global_cycle - start)
+             << " cycles), INT" << InterruptController::kTimerInt << " taken "
+             << intc.taken[InterruptController::kTimerInt] << " times" << endl;
+    }
+
+    // Multi-core workload: the Figure 4 kernel TB. Core 0 translates it and the
+    // other cores adopt its translations, as they all run the same image.
+    int prepareKernelWorkload(int id) {
+        core_id = id;
+        parseSoftwarePipelinedLoop();
+        TranslationBlock tb = translateKernelLoop();
+        registerTB(tb);
+        return tb.tb_id;
+    }
+
+    void adoptTranslations(const VLIWSimulator& other, int id) {
+        core_id = id;
+        guest_code = other.guest_code;
+        sploop_start_index = other.sploop_start_index;
+        symbols = other.symbols;
+        translation_blocks = other.translation_blocks;
+        tb_by_label = other.tb_by_label;
+        tb_index = other.tb_index;
+        current_image = other.current_image;
+        current_tb_id = other.current_tb_id;
+        code_cache.code_end = other.code_cache.code_end;
+        code_cache.hot_end = other.code_cache.hot_end;
+        if (code_cache.mem.base && other.code_cache.mem.base && (size_t)code_cache.code_end <= code_cache.mem.size) {
+            memcpy(code_cache.mem.base, other.code_cache.mem.base, code_cache.code_end);
+        }
+    }
+
+    void attachIpc(IpcFabric* fabric) {
+        ipc = fabric;
+        intc.ier |= 1u << IpcFabric::kIpcInt;
+    }
+
+    // Run kernel TBs until this core's clock reaches the quantum horizon. Cores
+    // in a sharing phase also post their progress to a per-core MSMC word; in
+    // an IPC phase every ipc_every-th TB mails a word to the next core and rings
+    // its doorbell, and arrived mail is consumed once IPCAR shows it.
+    void runQuantum(int kernel_tb, uint64_t horizon, bool touch_shared, uint32_t shared_base,
+                    int ipc_every, int core_count) {
+        uint32_t value = 0;
+        if (ipc) drainIpc(global_cycle);
+        cycle_budget = horizon > global_cycle ? (int64_t)(horizon - global_cycle) : 0;
+        for (;;) {
+            // A kernel iteration left part-way by the last quantum finishes first
+            bool completed = partial_tb >= 0 ? finishPartialTB() : runTBBudgeted(kernel_tb);
+            if (!completed) break;
+            kernel_runs++;
+            if (touch_shared) {
+                guestStore32(shared_base + 4 * core_id, (uint32_t)global_cycle);
+            }
+            if (ipc_every > 0 && kernel_runs % ipc_every == 0) {
+                int next = (core_id + 1) % core_count;
+                guestStore32(IpcFabric::kMailboxBase + IpcFabric::kMailboxSend + 0x10 * next, (uint32_t)global_cycle);
+                guestStore32(IpcFabric::kIPCGR + 4 * next, 1);
+            }
+            if (ipcar) {
+                while (guestLoad32(IpcFabric::kMailboxBase + IpcFabric::kMailboxCount, value) && value > 0) {
+                    guestLoad32(IpcFabric::kMailboxBase + IpcFabric::kMailboxRecv, value);
+                }
+                guestStore32(IpcFabric::kIPCAR + 4 * core_id, ipcar);
+            }
+        }
+    }
+
+    uint64_t ipcDelivered() const { return ipc_delivered; }
+    uint64_t ipcMeanLatency() const { return ipc_delivered ? ipc_latency_total / ipc_delivered : 0; }
+    uint64_t interruptsTaken(int n) const { return intc.taken[n]; }
+
+    uint64_t cycle() const { return global_cycle; }
+    uint64_t takeSharedAccesses() {
+        uint64_t n = shared_accesses;
+        shared_accesses = 0;
+        return n;
+    }
+
+    void writePaRAM(int set, const PaRAMSet& p) {
+        const uint32_t* words = (const uint32_t*)&p;
+        uint32_t addr = Edma3::kBase + Edma3::kPaRAM + set * sizeof(PaRAMSet);
+        for (size_t i = 0; i < sizeof(PaRAMSet) / 4; i++) {
+            guestStore32(addr + 4 * i, words[i]);
+        }
+    }
+
+    // Channel 0 fetches a 16 KB block from DDR into L2 and chains to channel 1,
+    // which writes it back out; the Figure 4 kernel TB runs meanwhile.
+    void simulateEdmaPingPong() {
+        const uint32_t block = 16u << 10;
+        const uint32_t src = 0x80000000, ping = 0x00800000, out = 0x80100000;
+        uint8_t* src_host = hostAddress(src, block, true);
+        if (!src_host || !hostAddress(out, block, true)) {
+            cout << "DDR too small for the transfer buffers, skipping" << endl;
+            return;
+        }
+        for (uint32_t i = 0; i < block; i++) src_host[i] = (uint8_t)(i * 7);
+        
+        PaRAMSet fetch = {};
+        fetch.opt = Edma3::kOptSyncDimAB | Edma3::kOptTcchEn | (1u << 12);  // Chain to channel 1
+        fetch.src = src;
+        fetch.a_b_cnt = (1u << 16) | block;
+        fetch.dst = ping;
+        fetch.link_bcntrld = Edma3::kNullLink;
+        fetch.ccnt = 1;
+        writePaRAM(0, fetch);
+        
+        PaRAMSet drain = fetch;
+        drain.opt = Edma3::kOptSyncDimAB | Edma3::kOptTcintEn | (1u << 12);  // Complete on TCC1
+        drain.src = ping;
+        drain.dst = out;
+        writePaRAM(1, drain);
+        
+        int kernel_tb = tb_by_label[sym_loop_state_1];
+        uint64_t start = global_cycle;
+        cout << "Triggering EDMA channel 0 (" << (block >> 10) << " KB DDR -> L2, chained to channel 1) at cycle "
+             << start << endl;
+        guestStore32(Edma3::kBase + Edma3::kESR, 1u << 0);
+        
+        uint32_t ipr = 0;
+        int overlapped = 0;
+        while (!(ipr & (1u << 1))) {
+            executeTB(kernel_tb);
+            overlapped++;
+            guestLoad32(Edma3::kBase + Edma3::kIPR, ipr);
+        }
+        guestStore32(Edma3::kBase + Edma3::kICR, ipr);
+        
+        const uint8_t* out_host = hostAddress(out, block);
+        bool match = out_host && memcmp(out_host, src_host, block) == 0;
+        cout << "Kernel TB" << kernel_tb << " executed " << overlapped << " times while transfers were in flight" << endl;
+        cout << "Transfer complete (IPR=0x" << hex << ipr << dec << ") after " << (global_cycle - start)
+             << " cycles, " << edma.bytes_moved << " bytes moved, destination "
+             << (match ? "verified" : "MISMATCH") << endl;
+        
+        // A-synchronized gather: 3 frames of 4 16-byte arrays, one array per
+        // event, every 64 bytes of the source packed into the destination
+        const uint32_t acnt = 16, bcnt = 4, ccnt = 3, gather = 0x00804000;
+        PaRAMSet strided = {};
+        strided.opt = Edma3::kOptTcintEn | (2u << 12);
+        strided.src = src;
+        strided.a_b_cnt = (bcnt << 16) | acnt;
+        strided.dst = gather;
+        strided.src_dst_bidx = (acnt << 16) | 64;
+        strided.link_bcntrld = (bcnt << 16) | Edma3::kNullLink;
+        strided.src_dst_cidx = (acnt << 16) | 64;
+        strided.ccnt = ccnt;
+        writePaRAM(2, strided);
+        int events = 0;
+        for (guestLoad32(Edma3::kBase + Edma3::kIPR, ipr); !(ipr & (1u << 2)) && events <= (int)(bcnt * ccnt); guestLoad32(Edma3::kBase + Edma3::kIPR, ipr)) {
+            guestStore32(Edma3::kBase + Edma3::kESR, 1u << 2);
+            events++;
+            while (edma.busy & (1u << 2)) executeTB(kernel_tb);
+        }
+        guestStore32(Edma3::kBase + Edma3::kICR, ipr);
+        const uint8_t* gather_host = hostAddress(gather, acnt * bcnt * ccnt);
+        match = gather_host != nullptr;
+        for (uint32_t k = 0; match && k < bcnt * ccnt; k++) {
+            match = memcmp(gather_host + k * acnt, src_host + k * 64, acnt) == 0;
+        }
+        cout << "A-sync gather: " << events << " events for " << (bcnt * ccnt) << " arrays, destination "
+             << (match ? "verified" : "MISMATCH") << endl;
+    }
+};
+
+// Barrier for core threads: arrivals are a lock-free counter, waiters spin
+// briefly on the generation word and then sleep on it with a futex. The last
+// core to arrive runs the completion step before releasing the others.
+class SpinFutexBarrier {
+public:
+    static const int kSpinIterations = 2000;
+
+    explicit SpinFutexBarrier(int parties) : parties(parties), arrived(0), generation(0) {}
+
+    template <typename Completion>
+    void wait(Completion&& on_last) {
+        uint32_t gen = generation.load(memory_order_acquire);
+        if (arrived.fetch_add(1, memory_order_acq_rel) + 1 == parties) {
+            on_last();
+            arrived.store(0, memory_order_relaxed);
+            generation.fetch_add(1, memory_order_release);
+            syscall(SYS_futex, (uint32_t*)&generation, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+            return;
+        }
+        for (int i = 0; i < kSpinIterations; i++) {
+            if (generation.load(memory_order_acquire) != gen) return;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        while (generation.load(memory_order_acquire) == gen) {
+            syscall(SYS_futex, (uint32_t*)&generation, FUTEX_WAIT_PRIVATE, gen, nullptr, nullptr, 0);
+        }
+    }
+
+private:
+    const int parties;
+    atomic<int> arrived;
+    atomic<uint32_t> generation;
+};
+
+// Quantum-synchronized multi-core run. Each core runs on its own host thread
+// up to a shared cycle horizon and then meets the others at the barrier. The
+// quantum halves while any core touched shared MSMC memory during the last one
+// and doubles while the cores stay independent; mail between cores does not
+// shrink it.
+class MulticoreRunner {
+public:
+    static const uint32_t kMsmcBase = 0x0C000000;
+    static const size_t kMsmcSize = 4u << 20;
+    static constexpr uint64_t kMinQuantum = 100;
+    static constexpr uint64_t kMaxQuantum = 20000;
+
+    MulticoreRunner(int core_count, const SimOptions& options)
+        : barrier(core_count), horizon(0), quantum(1000), quanta(0) {
+        SimOptions core_options = options;
+        core_options.ddr_file.clear();
+        core_options.fifo_in.clear();
+        core_options.fifo_out.clear();
+        msmc = HostMapping::map(kMsmcSize, false, options.huge_pages);
+        ipc.reset(new IpcFabric());
+        for (int id = 0; id < core_count; id++) {
+            cores.emplace_back(new VLIWSimulator(core_options));
+            cores.back()->attachSharedRegion("MSMC", kMsmcBase, msmc);
+            cores.back()->attachIpc(ipc.get());
+        }
+    }
+
+    ~MulticoreRunner() {
+        cores.clear();
+        ipc.reset();
+        msmc.unmap();
+    }
+
+    // Odd cores share MSMC during the middle third of the run and all cores pass
+    // mail around a ring in the last third; the first third is independent work
+    void run(uint64_t total_cycles) {
+        cout << "\n=== Quantum-Synchronized Multi-Core Run (" << cores.size() << " cores) ===" << endl;
+        kernel_tb = cores[0]->prepareKernelWorkload(0);
+        for (size_t id = 1; id < cores.size(); id++) {
+            cores[id]->adoptTranslations(*cores[0], (int)id);
+        }
+        
+        total = total_cycles;
+        horizon = min(total, quantum);
+        vector<thread> threads;
+        for (size_t id = 0; id < cores.size(); id++) {
+            threads.emplace_back([this, id] { coreThread((int)id); });
+        }
+        for (auto& t : threads) t.join();
+        
+        cout << "Quanta: " << quanta << ", quantum range " << min_seen << "-" << max_seen << " cycles" << endl;
+        cout << "Quantum trace:";
+        for (size_t i = 0; i < trace.size(); i++) cout << " " << trace[i];
+        cout << endl;
+        cout << "Mail phase: " << mail_quanta << " quanta, quantum range " << mail_min << "-" << mail_max
+             << " cycles" << endl;
+        for (size_t id = 0; id < cores.size(); id++) {
+            cout << "  Core " << id << " stopped at cycle " << cores[id]->cycle() << ", "
+                 << cores[id]->ipcDelivered() << " IPC deliveries (mean latency "
+                 << cores[id]->ipcMeanLatency() << " cycles), INT" << IpcFabric::kIpcInt << " taken "
+                 << cores[id]->interruptsTaken(IpcFabric::kIpcInt) << " times" << endl;
+        }
+        cout << "  IPC messages dropped: " << ipc->dropped.load() << endl;
+    }
+
+private:
+    vector<unique_ptr<VLIWSimulator>> cores;
+    HostMapping msmc;
+    unique_ptr<IpcFabric> ipc;
+    SpinFutexBarrier barrier;
+    uint64_t horizon;   // Written only by the barrier's completion step
+    uint64_t quantum;
+    uint64_t total = 0;
+    int kernel_tb = -1;
+    uint64_t quanta;
+    uint64_t min_seen = ~0ull, max_seen = 0;
+    vector<uint64_t> trace;  // Quantum sizes, recorded when they change
+    uint64_t mail_quanta = 0, mail_min = ~0ull, mail_max = 0;  // After ipcStart()
+
+    void coreThread(int id) {
+        VLIWSimulator& core = *cores[id];
+        uint64_t limit;
+        do {
+            limit = horizon;
+            bool sharing = (id % 2 == 1) && limit > total / 3 && limit <= ipcStart();
+            int ipc_every = limit > ipcStart() ? 16 : 0;
+            core.runQuantum(kernel_tb, limit, sharing, kMsmcBase, ipc_every, (int)cores.size());
+            barrier.wait([this] { endQuantum(); });
+        } while (limit < total);
+    }
+
+    // Runs on the last core to arrive, while every other core is parked
+    void endQuantum() {
+        uint64_t shared = 0;
+        for (auto& core : cores) shared += core->takeSharedAccesses();
+        quanta++;
+        min_seen = min(min_seen, quantum);
+        max_seen = max(max_seen, quantum);
+        if (trace.empty() || trace.back() != quantum) trace.push_back(quantum);
+        if (horizon > ipcStart()) {
+            mail_quanta++;
+            mail_min = min(mail_min, quantum);
+            mail_max = max(mail_max, quantum);
+        }
+        quantum = shared > 0 ? max(kMinQuantum, quantum / 2) : min(kMaxQuantum, quantum * 2);
+        horizon = min(total, horizon + quantum);
+    }
+
+    // Cycle at which the cores start passing mail
+    uint64_t ipcStart() const { return 2 * total / 3; }
 };
 
-int main() {
-    VLIWSimulator simulator;
-    simulator.simulateExecution();
+// Whole-string decimal option value in [lo, hi]
+static bool parseOptionValue(const char* text, unsigned long lo, unsigned long hi, unsigned long& value) {
+    char* end;
+    errno = 0;
+    value = strtoul(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && text[0] != '-' && value >= lo && value <= hi;
+}
+
+int main(int argc, char** argv) {
+    SimOptions options;
+    unsigned long value;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--huge-pages") {
+            options.huge_pages = true;
+        } else if (arg == "--ddr-mb" && i + 1 < argc && parseOptionValue(argv[++i], 1, 2048, value)) {
+            options.ddr_size = (size_t)value << 20;
+        } else if ((arg == "--ddr-file" || arg == "--ddr-file-cow") && i + 1 < argc) {
+            options.ddr_file = argv[++i];
+            options.ddr_file_cow = (arg == "--ddr-file-cow");
+        } else if (arg == "--fifo-in" && i + 1 < argc) {
+            options.fifo_in = argv[++i];
+        } else if (arg == "--fifo-out" && i + 1 < argc) {
+            options.fifo_out = argv[++i];
+        } else if (arg == "--cores" && i + 1 < argc && parseOptionValue(argv[++i], 1, INT_MAX, value)) {
+            if (value > (unsigned long)IpcFabric::kMaxCores) {
+                cerr << "--cores supports at most " << IpcFabric::kMaxCores << " cores" << endl;
+                return 1;
+            }
+            options.cores = (int)value;
+        } else if (arg == "--gdb" && i + 1 < argc && parseOptionValue(argv[++i], 1, 65535, value)) {
+            options.gdb_port = (int)value;
+        } else if (arg == "--host-threads" && i + 1 < argc && parseOptionValue(argv[++i], 1, 256, value)) {
+            options.host_threads = (int)value;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--huge-pages] [--ddr-mb N]"
+                 << " [--ddr-file PATH | --ddr-file-cow PATH]"
+                 << " [--fifo-in PATH] [--fifo-out PATH] [--cores N] [--gdb PORT]"
+                 << " [--host-threads N]" << endl;
+            return 1;
+        }
+    }
+    
+    VLIWSimulator simulator(options);
+    GdbStub gdb;
+    if (options.gdb_port) {
+        if (!gdb.listenAndAccept(options.gdb_port)) {
+            cerr << "Cannot listen for GDB on port " << options.gdb_port << endl;
+            return 1;
+        }
+        simulator.attachDebugger(&gdb);
+        gdb.serve(simulator, "S05");  // Stopped before the first instruction
+    }
+    // A GDB kill ends the run at the next phase; returning from main() still
+    // flushes semihost output and the FIFO and unmaps guest memory
+    if (!gdb.killRequested()) simulator.simulateExecution();
+    
+    if (options.cores > 1 && !gdb.killRequested()) {
+        cout << "\n\n********** PART 9: Multi-Core Quantum Synchronization **********\n" << endl;
+        MulticoreRunner runner(options.cores, options);
+        runner.run(300000);
+    }
+    
+    if (!gdb.killRequested()) simulator.simulateExtensions();
+    gdb.exited(0);
     
     return 0;
 }